@@ -0,0 +1,36 @@
+#include "AdmissionFilter.hpp"
+
+AdmissionFilter::AdmissionFilter(Kind kind, std::vector<int> keys, uint64_t dataset_size, unsigned bloom_bits_per_key)
+    : kind(kind), members(std::move(keys))
+{
+    if (kind == Kind::Bitset)
+    {
+        range = dataset_size + 1;
+        bits.assign((range + 63) / 64, 0);
+        for (int key : members)
+        {
+            uint64_t k = static_cast<uint32_t>(key);
+            if (k < range)
+                bits[k >> 6] |= 1ull << (k & 63);
+            else
+                outliers.push_back(key);
+        }
+        std::sort(outliers.begin(), outliers.end());
+        return;
+    }
+
+    if (members.empty())
+        return;
+    uint64_t total_bits = std::max<uint64_t>(1, members.size()) * std::max(1u, bloom_bits_per_key);
+    num_blocks = std::min<uint64_t>(UINT32_MAX, (total_bits + 255) / 256);
+    blocks.assign(num_blocks * BLOCK_WORDS, 0);
+    for (int key : members)
+    {
+        uint64_t h = hash(key);
+        uint32_t *block = &blocks[((h >> 32) * num_blocks >> 32) * BLOCK_WORDS];
+        uint32_t mask[BLOCK_WORDS];
+        blockMask(static_cast<uint32_t>(h), mask);
+        for (uint32_t i = 0; i < BLOCK_WORDS; ++i)
+            block[i] |= mask[i];
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef ADMISSION_FILTER_HPP
+#define ADMISSION_FILTER_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// Keys a replica admits on a remote hit, built in bulk from the top R_opt keys
+// at each CBA interval and immutable afterwards, so workers share it through a
+// shared_ptr without locking.
+//
+// Bitset is exact: one bit per key of [0, dataset_size], with the rare keys
+// outside that range kept in a sorted vector. Bloom is a split-block Bloom
+// filter (eight 32-bit words per 32-byte block, one bit set per word) whose
+// memory follows the number of keys instead of the key space, at the cost of
+// admitting a small fraction of false positives.
+class AdmissionFilter
+{
+public:
+    enum class Kind
+    {
+        Bitset,
+        Bloom,
+    };
+
+private:
+    static constexpr uint32_t BLOCK_WORDS = 8;
+
+    Kind kind = Kind::Bitset;
+    std::vector<int> members;
+    // Bitset
+    std::vector<uint64_t> bits;
+    uint64_t range = 0;
+    std::vector<int> outliers;
+    // Bloom
+    std::vector<uint32_t> blocks;
+    uint64_t num_blocks = 0;
+
+    static uint64_t hash(int key)
+    {
+        uint64_t h = static_cast<uint32_t>(key) * 0x9E3779B97F4A7C15ull;
+        return h ^ (h >> 29);
+    }
+
+    // One bit per word, picked by the high bits of salted multiplies
+    static void blockMask(uint32_t h, uint32_t mask[BLOCK_WORDS])
+    {
+        static constexpr uint32_t SALT[BLOCK_WORDS] = {0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+                                                       0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U};
+        for (uint32_t i = 0; i < BLOCK_WORDS; ++i)
+            mask[i] = 1u << ((h * SALT[i]) >> 27);
+    }
+
+public:
+    AdmissionFilter() = default;
+    // bloom_bits_per_key only applies to Kind::Bloom
+    AdmissionFilter(Kind kind, std::vector<int> keys, uint64_t dataset_size, unsigned bloom_bits_per_key);
+
+    bool contains(int key) const
+    {
+        if (kind == Kind::Bitset)
+        {
+            uint64_t k = static_cast<uint32_t>(key);
+            if (k < range)
+                return (bits[k >> 6] >> (k & 63)) & 1;
+            return !outliers.empty() && std::binary_search(outliers.begin(), outliers.end(), key);
+        }
+        if (num_blocks == 0)
+            return false;
+        uint64_t h = hash(key);
+        const uint32_t *block = &blocks[((h >> 32) * num_blocks >> 32) * BLOCK_WORDS];
+        uint32_t mask[BLOCK_WORDS];
+        blockMask(static_cast<uint32_t>(h), mask);
+        uint32_t missing = 0;
+        for (uint32_t i = 0; i < BLOCK_WORDS; ++i)
+            missing |= mask[i] & ~block[i];
+        return missing == 0;
+    }
+
+    Kind filterKind() const { return kind; }
+    // The keys the filter was built from
+    const std::vector<int> &keys() const { return members; }
+};
+
+#endif // ADMISSION_FILTER_HPP
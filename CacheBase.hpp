@@ -3,6 +3,7 @@
 
 #include <set>
 #include <cstddef>
+#include <functional>
 
 class CacheBase
 {
@@ -14,6 +15,22 @@ public:
     virtual std::set<int> getKeys() = 0;
     virtual bool contains(int key) = 0;
     virtual void remove(int key) = 0;
+    // Hint that key is about to be looked up; engines pull its index slot,
+    // or hash bucket and first node, into cache
+    virtual void prefetch(int /*key*/) const {}
+
+    // Called with every key that leaves the cache, by eviction or remove().
+    // A put that cannot keep its key (a zero capacity) reports it too.
+    void setEvictionCallback(std::function<void(int)> callback) { on_evict = std::move(callback); }
+
+protected:
+    std::function<void(int)> on_evict;
+
+    void evicted(int key)
+    {
+        if (on_evict)
+            on_evict(key);
+    }
 };
 
 #endif // CACHE_BASE_HPP
@@ -0,0 +1,87 @@
+#ifndef CACHE_POLICIES_HPP
+#define CACHE_POLICIES_HPP
+
+#include "CacheBase.hpp"
+#include "LRUCache.hpp"
+#include "FlatLRUCache.hpp"
+#include "S3FIFOCache.hpp"
+#include "RingS3FIFOCache.hpp"
+#include <memory>
+#include <string>
+
+// A policy names the cache engine each replica owns. ReplicaManager<Policy>
+// holds the concrete (final) engine type, so cache calls on the request path
+// are statically dispatched and can be inlined. DynamicPolicy keeps the
+// CacheBase virtual path for engines only known through makeCache().
+
+std::unique_ptr<CacheBase> makeCache(const std::string &cache_type, size_t cache_size);
+
+template <typename Engine>
+struct StaticPolicy
+{
+    using Cache = Engine;
+
+    static std::unique_ptr<Cache> create(size_t cache_size, const std::string &)
+    {
+        return std::make_unique<Cache>(cache_size);
+    }
+};
+
+struct LRUPolicy : StaticPolicy<LRUCache>
+{
+    static constexpr const char *name = "LRU";
+};
+
+struct FlatLRUPolicy : StaticPolicy<FlatLRUCache>
+{
+    static constexpr const char *name = "FlatLRU";
+};
+
+struct S3FIFOPolicy : StaticPolicy<S3FIFOCache>
+{
+    static constexpr const char *name = "S3FIFO";
+};
+
+struct RingS3FIFOPolicy : StaticPolicy<RingS3FIFOCache>
+{
+    static constexpr const char *name = "RingS3FIFO";
+};
+
+struct DynamicPolicy
+{
+    using Cache = CacheBase;
+    static constexpr const char *name = "dynamic";
+
+    static std::unique_ptr<Cache> create(size_t cache_size, const std::string &cache_type)
+    {
+        return makeCache(cache_type, cache_size);
+    }
+};
+
+// Compile-time registry: every policy listed here gets its own instantiation
+// of the simulation core (see the explicit instantiations at the bottom of
+// ReplicaManager.cpp and RequestProcessor.cpp).
+#define FOR_EACH_STATIC_CACHE_POLICY(X) \
+    X(LRUPolicy)                        \
+    X(FlatLRUPolicy)                    \
+    X(S3FIFOPolicy)                     \
+    X(RingS3FIFOPolicy)
+
+#define FOR_EACH_CACHE_POLICY(X)     \
+    FOR_EACH_STATIC_CACHE_POLICY(X) \
+    X(DynamicPolicy)
+
+// Calls f(Policy{}) for the registered policy named cache_type, falling back
+// to DynamicPolicy for anything else.
+template <typename F>
+void dispatchCachePolicy(const std::string &cache_type, F &&f)
+{
+#define DISPATCH_CACHE_POLICY(P) \
+    if (cache_type == P::name)   \
+        return f(P{});
+    FOR_EACH_STATIC_CACHE_POLICY(DISPATCH_CACHE_POLICY)
+#undef DISPATCH_CACHE_POLICY
+    f(DynamicPolicy{});
+}
+
+#endif // CACHE_POLICIES_HPP
@@ -1,4 +1,6 @@
 #include "ConfigManager.hpp"
+#include <algorithm>
+#include <cmath>
 #include <fstream>
 #include <iostream>
 
@@ -9,6 +11,11 @@ ConfigManager::ConfigManager(const std::string &config_file)
     loadConfig(config_file);
 }
 
+ConfigManager::ConfigManager(const json &config)
+{
+    applyConfig(config);
+}
+
 void ConfigManager::loadConfig(const std::string &config_file)
 {
     std::ifstream file(config_file);
@@ -20,6 +27,12 @@ void ConfigManager::loadConfig(const std::string &config_file)
 
     json config;
     file >> config;
+    applyConfig(config);
+}
+
+void ConfigManager::applyConfig(const json &config)
+{
+    settings = config;
 
     num_threads = config["num_threads"];
     num_replicas = config["num_replicas"];
@@ -31,13 +44,143 @@ void ConfigManager::loadConfig(const std::string &config_file)
     enable_de_duplication = config["enable_de_duplication"];
     is_access_rate_fixed = config["is_access_rate_fixed"];
     fixed_access_rate = config["fixed_access_rate_value"];
-    update_interval = config.value("cba_update_interval", 10);
+    // Configs may give the interval as a fractional request count; round it
+    // instead of letting the conversion truncate
+    update_interval = std::max<uint64_t>(1, std::llround(config.value("cba_update_interval", 10.0)));
     latency_local = config["latency_local"];
     latency_rdma = config["latency_rdma"];
     latency_disk = config["latency_disk"];
     workload_folder = config["workload_folder"];
     cache_type = config["cache_type"];
+    stream_memory_budget_mb = config.value("stream_memory_budget_mb", 0);
+    cba_optimizer = config.value("cba_optimizer", "scan");
+    if (cba_optimizer != "scan" && cba_optimizer != "search")
+    {
+        std::cerr << "Error: cba_optimizer must be \"scan\" or \"search\", got " << cba_optimizer << "\n";
+        exit(1);
+    }
+    cba_mode = config.value("cba_mode", "inline");
+    if (cba_mode != "inline" && cba_mode != "async" && cba_mode != "deterministic")
+    {
+        std::cerr << "Error: cba_mode must be \"inline\", \"async\" or \"deterministic\", got " << cba_mode << "\n";
+        exit(1);
+    }
+    cba_apply_offset = config.value("cba_apply_offset", update_interval / 4);
+    admission_filter = config.value("admission_filter", "bitset");
+    if (admission_filter != "bitset" && admission_filter != "bloom")
+    {
+        std::cerr << "Error: admission_filter must be \"bitset\" or \"bloom\", got " << admission_filter << "\n";
+        exit(1);
+    }
+    admission_bloom_bits_per_key = config.value("admission_bloom_bits_per_key", 10);
+    frequency_tracking = config.value("frequency_tracking", "exact");
+    if (frequency_tracking != "exact" && frequency_tracking != "sketch" && frequency_tracking != "decayed")
+    {
+        std::cerr << "Error: frequency_tracking must be \"exact\", \"sketch\" or \"decayed\", got " << frequency_tracking << "\n";
+        exit(1);
+    }
+    sketch_memory_mb = config.value("sketch_memory_mb", 64);
+    sketch_top_k = config.value("sketch_top_k", 1 << 20);
+    frequency_half_life = config.value("frequency_half_life", update_interval);
+    cba_trigger = config.value("cba_trigger", "interval");
+    if (cba_trigger != "interval" && cba_trigger != "drift")
+    {
+        std::cerr << "Error: cba_trigger must be \"interval\" or \"drift\", got " << cba_trigger << "\n";
+        exit(1);
+    }
+    cba_min_interval = config.value("cba_min_interval", update_interval / 4);
+    cba_max_interval = config.value("cba_max_interval", update_interval * 4);
+    cba_drift_threshold = config.value("cba_drift_threshold", 0.05);
+    cba_drift_top_k = config.value("cba_drift_top_k", 1 << 16);
+    miss_ratio_curve = config.value("miss_ratio_curve", false);
+    mrc_points = config.value("mrc_points", 100);
+    // Stack distances only describe LRU
+    if (miss_ratio_curve && cache_type != "LRU" && cache_type != "FlatLRU")
+    {
+        std::cerr << "Error: miss_ratio_curve needs cache_type \"LRU\" or \"FlatLRU\", got " << cache_type << "\n";
+        exit(1);
+    }
+    if (mrc_points < 1)
+    {
+        std::cerr << "Error: mrc_points must be at least 1, got " << mrc_points << "\n";
+        exit(1);
+    }
+    sample_rate = config.value("sample_rate", 1.0);
+    if (!(sample_rate > 0 && sample_rate <= 1))
+    {
+        std::cerr << "Error: sample_rate must be in (0, 1], got " << sample_rate << "\n";
+        exit(1);
+    }
+    if (sample_rate < 1 && miss_ratio_curve)
+    {
+        std::cerr << "Error: sample_rate does not apply to miss_ratio_curve\n";
+        exit(1);
+    }
+    key_shards = config.value("key_shards", 1);
+    if (key_shards < 1)
+    {
+        std::cerr << "Error: key_shards must be at least 1, got " << key_shards << "\n";
+        exit(1);
+    }
+    if (key_shards > 1 && (sample_rate < 1 || miss_ratio_curve || num_threads > 1 || config.contains("sweep")))
+    {
+        std::cerr << "Error: key_shards cannot be combined with sample_rate, miss_ratio_curve, num_threads or sweep\n";
+        exit(1);
+    }
+    replica_pipeline = config.value("replica_pipeline", false);
+    // The pipeline reproduces the serial run only when the CBA runs at fixed
+    // request counts and sees the same frequencies whatever the serving order
+    if (replica_pipeline && (num_threads > 1 || cba_mode != "inline" || cba_trigger != "interval" ||
+                             frequency_tracking != "exact" || key_shards > 1))
+    {
+        std::cerr << "Error: replica_pipeline needs num_threads 1, cba_mode \"inline\", cba_trigger \"interval\", "
+                     "frequency_tracking \"exact\" and no key_shards\n";
+        exit(1);
+    }
+    routing = config.value("routing", "sticky");
+    if (routing != "sticky" && routing != "random" && routing != "hash" && routing != "two_choices")
+    {
+        std::cerr << "Error: routing must be \"sticky\", \"random\", \"hash\" or \"two_choices\", got " << routing << "\n";
+        exit(1);
+    }
+    routing_seed = config.value("routing_seed", uint64_t(1));
+    latency_model = config.value("latency_model", "constant");
+    if (latency_model != "constant" && latency_model != "lognormal")
+    {
+        std::cerr << "Error: latency_model must be \"constant\" or \"lognormal\", got " << latency_model << "\n";
+        exit(1);
+    }
+    latency_sigma = config.value("latency_sigma", 0.5);
+    if (latency_sigma < 0)
+    {
+        std::cerr << "Error: latency_sigma must not be negative, got " << latency_sigma << "\n";
+        exit(1);
+    }
+    latency_seed = config.value("latency_seed", uint64_t(1));
+    // A number of requests, or "cba" for the CBA update interval
+    if (config.contains("metrics_window") && config["metrics_window"].is_string())
+    {
+        if (config["metrics_window"] != "cba")
+        {
+            std::cerr << "Error: metrics_window must be a number of requests or \"cba\", got " << config["metrics_window"] << "\n";
+            exit(1);
+        }
+        metrics_window = update_interval;
+    }
+    else
+    {
+        metrics_window = config.value("metrics_window", uint64_t(0));
+    }
+    // Windows are cut from one worker's counters between requests
+    if (metrics_window > 0 && (num_threads > 1 || key_shards > 1))
+    {
+        std::cerr << "Error: metrics_window cannot be combined with num_threads above 1 or key_shards\n";
+        exit(1);
+    }
+    sweep_threads = config.value("sweep_threads", 0);
 
+    if (sample_rate < 1)
+        applySampleRate();
     updateCacheSize();
 }
 
@@ -57,10 +200,112 @@ void ConfigManager::printConfig()
               << "  Local latency: " << latency_local << " us\n"
               << "  RDMA latency: " << latency_rdma << " us\n"
               << "  Disk latency: " << latency_disk << " us\n"
-              << "  Workload folder: " << workload_folder << "\n";
+              << "  Latency model: " << latency_model << (latency_model == "lognormal" ? " (sigma " + std::to_string(latency_sigma) + ")" : "") << "\n"
+              << "  Workload folder: " << workload_folder << "\n"
+              << "  CBA optimizer: " << cba_optimizer << "\n"
+              << "  CBA trigger: " << cba_trigger
+              << (cba_trigger == "drift" ? " (threshold " + std::to_string(cba_drift_threshold) + " over the top " + std::to_string(cba_drift_top_k) + " keys, every " +
+                                               std::to_string(cba_min_interval) + " to " + std::to_string(cba_max_interval) + " requests)"
+                                         : "")
+              << "\n"
+              << "  CBA mode: " << cba_mode << (cba_mode == "deterministic" ? ", applied after " + std::to_string(cba_apply_offset) + " requests" : "") << "\n"
+              << "  Admission filter: " << admission_filter << (admission_filter == "bloom" ? " (" + std::to_string(admission_bloom_bits_per_key) + " bits per key)" : "") << "\n"
+              << "  Frequency tracking: " << frequency_tracking << (frequency_tracking == "sketch" ? " (" + std::to_string(sketch_memory_mb) + " MB, top " + std::to_string(sketch_top_k) + " keys)" : "")
+              << (frequency_tracking == "decayed" ? " (half-life " + std::to_string(frequency_half_life) + " requests)" : "") << "\n"
+              << "  Miss-ratio curve: " << (miss_ratio_curve ? std::to_string(mrc_points) + " capacities" : "off") << "\n"
+              << "  Sample rate: " << sample_rate << "\n"
+              << "  Key shards: " << key_shards << "\n"
+              << "  Routing: " << routing << " (seed " << routing_seed << ")\n"
+              << "  Metrics window: " << (metrics_window ? std::to_string(metrics_window) + " requests" : "off") << "\n"
+              << "  Replica pipeline: " << (replica_pipeline ? "true" : "false") << "\n"
+              << "  Trace streaming budget: " << (stream_memory_budget_mb ? std::to_string(stream_memory_budget_mb) + " MB" : "off") << "\n";
 }
 
 void ConfigManager::updateCacheSize()
 {
     cache_size = static_cast<int>(cache_percentage * total_dataset_size);
-}
\ No newline at end of file
+}
+
+// A sampled run sees a sample_rate share of the keys and of the requests, so
+// the dataset and every setting counted in requests or keys shrink with it
+void ConfigManager::applySampleRate()
+{
+    auto scale = [this](uint64_t value)
+    { return static_cast<uint64_t>(std::llround(value * sample_rate)); };
+    total_dataset_size = static_cast<int>(std::max<uint64_t>(1, scale(total_dataset_size)));
+    update_interval = std::max<uint64_t>(1, scale(update_interval));
+    cba_apply_offset = scale(cba_apply_offset);
+    cba_min_interval = scale(cba_min_interval);
+    cba_max_interval = scale(cba_max_interval);
+    cba_drift_top_k = scale(cba_drift_top_k);
+    frequency_half_life = scale(frequency_half_life);
+    if (metrics_window > 0)
+        metrics_window = std::max<uint64_t>(1, scale(metrics_window));
+}
+
+std::vector<ConfigManager> ConfigManager::sweepConfigs() const
+{
+    std::vector<ConfigManager> configs;
+    if (!settings.contains("sweep"))
+        return configs;
+
+    const json &matrix = settings["sweep"];
+    if (!matrix.is_object() || matrix.empty())
+    {
+        std::cerr << "Error: sweep must be an object mapping settings to lists of values\n";
+        exit(1);
+    }
+    size_t combinations = 1;
+    for (auto &[key, values] : matrix.items())
+    {
+        if (!values.is_array() || values.empty())
+        {
+            std::cerr << "Error: sweep values for " << key << " must be a non-empty list\n";
+            exit(1);
+        }
+        // Every configuration replays the same trace on its own thread
+        if (key == "workload_folder" || key == "num_threads" || key == "sweep" || key == "sweep_threads")
+        {
+            std::cerr << "Error: " << key << " cannot be swept\n";
+            exit(1);
+        }
+        combinations *= values.size();
+    }
+
+    // Settings the results filename already tells apart
+    static const std::vector<std::string> named = {"cache_type", "cache_percentage", "rdma_enabled", "enable_cba",
+                                                   "is_access_rate_fixed", "enable_de_duplication"};
+    for (size_t c = 0; c < combinations; ++c)
+    {
+        json config = settings;
+        config.erase("sweep");
+        std::string suffix;
+        size_t rest = c;
+        for (auto &[key, values] : matrix.items())
+        {
+            const json &value = values[rest % values.size()];
+            rest /= values.size();
+            config[key] = value;
+            if (std::find(named.begin(), named.end(), key) == named.end())
+                suffix += "_" + key + "-" + (value.is_string() ? value.get<std::string>() : value.dump());
+        }
+        configs.emplace_back(config);
+        configs.back().result_suffix = suffix;
+    }
+    return configs;
+}
+
+std::vector<ConfigManager> ConfigManager::shardConfigs() const
+{
+    json config = settings;
+    config.erase("key_shards");
+    config["sample_rate"] = 1.0 / key_shards;
+    std::vector<ConfigManager> configs;
+    for (int shard = 0; shard < key_shards; ++shard)
+    {
+        configs.emplace_back(config);
+        configs.back().key_shards = key_shards;
+        configs.back().key_shard = shard;
+    }
+    return configs;
+}
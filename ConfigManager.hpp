@@ -2,6 +2,7 @@
 #define CONFIG_MANAGER_HPP
 
 #include <string>
+#include <vector>
 #include "nlohmann/json.hpp"
 
 class ConfigManager
@@ -24,11 +25,58 @@ public:
     int latency_disk;
     std::string workload_folder;
     std::string cache_type;
+    uint64_t stream_memory_budget_mb;
+    std::string cba_optimizer;
+    std::string cba_mode;
+    uint64_t cba_apply_offset;
+    std::string admission_filter;
+    unsigned admission_bloom_bits_per_key;
+    std::string frequency_tracking;
+    uint64_t sketch_memory_mb;
+    uint64_t sketch_top_k;
+    uint64_t frequency_half_life;
+    std::string cba_trigger;
+    uint64_t cba_min_interval;
+    uint64_t cba_max_interval;
+    double cba_drift_threshold;
+    uint64_t cba_drift_top_k;
+    bool miss_ratio_curve;
+    int mrc_points;
+    // Share of the key space simulated; total_dataset_size and the request
+    // counts of the CBA settings are already scaled by it
+    double sample_rate;
+    // Key-sharded runs simulate shard key_shard of key_shards hash slices
+    int key_shards;
+    int key_shard = 0;
+    bool replica_pipeline;
+    std::string routing;
+    uint64_t routing_seed;
+    std::string latency_model;
+    double latency_sigma;
+    uint64_t latency_seed;
+    // Requests per row of the time-series file, 0 for none
+    uint64_t metrics_window;
+    // Sweep only: the swept settings that the results filename does not
+    // already encode, so every configuration writes its own file
+    std::string result_suffix;
+    unsigned sweep_threads;
 
     ConfigManager(const std::string &config_file);
+    explicit ConfigManager(const nlohmann::json &config);
     void loadConfig(const std::string &config_file);
+    void applyConfig(const nlohmann::json &config);
     void printConfig();
     void updateCacheSize();
+    void applySampleRate();
+    // One configuration per combination of the optional "sweep" matrix, an
+    // object mapping setting names to lists of values; empty without one
+    std::vector<ConfigManager> sweepConfigs() const;
+    // One configuration per key shard, each simulating its slice of the keys
+    // at 1 / key_shards of the dataset and capacity
+    std::vector<ConfigManager> shardConfigs() const;
+
+private:
+    nlohmann::json settings;
 };
 
 #endif // CONFIG_MANAGER_HPP
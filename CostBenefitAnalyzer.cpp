@@ -3,14 +3,16 @@
 #include <fstream>
 #include <numeric>
 #include <chrono>
+#include <thread>
 
-extern std::atomic<int> completed_requests;
+extern std::atomic<uint64_t> completed_requests;
 
 CostBenefitAnalyzer::CostBenefitAnalyzer(uint64_t num_replicas, uint64_t total_dataset_size, uint64_t _cache_size,
-                                         uint64_t latency_local, uint64_t latency_rdma, uint64_t latency_disk)
+                                         uint64_t latency_local, uint64_t latency_rdma, uint64_t latency_disk,
+                                         RedundancyOptimizer optimizer)
     : num_replicas(num_replicas), total_dataset_size(total_dataset_size), cache_size(total_dataset_size),
       latency_local(latency_local), latency_rdma(latency_rdma), latency_disk(latency_disk),
-      R_opt(0), best_performance(std::numeric_limits<double>::lowest())
+      R_opt(0), optimizer(optimizer)
 {
     std::cout << "Cache size: " << cache_size << std::endl;
     std::cout << "Total dataset size: " << total_dataset_size << std::endl;
@@ -20,15 +22,9 @@ CostBenefitAnalyzer::CostBenefitAnalyzer(uint64_t num_replicas, uint64_t total_d
     std::cout << "Num replicas: " << num_replicas << std::endl;
 }
 
-void CostBenefitAnalyzer::updateAccessFrequencies(const std::vector<std::pair<uint64_t, uint64_t>> &new_frequencies)
+void CostBenefitAnalyzer::updateAccessFrequencies(FrequencyRanking new_frequencies)
 {
-    access_frequencies = new_frequencies;
-    sum_cdf();
-}
-
-bool CostBenefitAnalyzer::shouldCacheLocally(const std::string &key)
-{
-    return dup_keys_map[std::stoi(key)];
+    access_frequencies = std::move(new_frequencies);
 }
 
 uint64_t CostBenefitAnalyzer::getOptimalRedundancy() const
@@ -36,105 +32,158 @@ uint64_t CostBenefitAnalyzer::getOptimalRedundancy() const
     return R_opt;
 }
 
-void CostBenefitAnalyzer::update_dup_keys_map()
-{
-    dup_keys_map.clear();
-    for (uint64_t i = 0; i < R_opt && i < access_frequencies.size(); ++i)
-    {
-        dup_keys_map[access_frequencies[i].second] = true;
-    }
-}
-
-void CostBenefitAnalyzer::sum_cdf()
+// The R_opt most frequently accessed keys, which every replica may hold a
+// copy of; fewer if fewer keys were accessed
+std::vector<int> CostBenefitAnalyzer::getReplicatedKeys() const
 {
-
-    uint64_t sum = 0;
-    c_sum.clear();
-    for (const auto &kv : access_frequencies)
-    {
-        sum += kv.first;
-        c_sum.emplace_back(kv.second, sum);
-    }
+    return access_frequencies.topKeys(R_opt);
 }
 
-uint64_t CostBenefitAnalyzer::get_sum_freq_till_index(uint64_t start, uint64_t end)
+uint64_t CostBenefitAnalyzer::get_sum_freq_till_index(uint64_t start, uint64_t end) const
 {
-    if (start >= c_sum.size())
+    if (start >= access_frequencies.size())
     {
         return 1;
     }
 
-    if (end > c_sum.size())
+    if (end > access_frequencies.size())
     {
         return 1;
     }
 
-    uint64_t start_value = start ? c_sum[start - 1].second : 0;
-    uint64_t end_value = c_sum[end - 1].second;
+    uint64_t start_value = access_frequencies.prefixSum(start);
+    uint64_t end_value = access_frequencies.prefixSum(end);
     if (end_value == start_value)
         return 1;
     return end_value - start_value;
 }
 
-uint64_t CostBenefitAnalyzer::calculate_performance(uint64_t water_mark_local, uint64_t water_mark_remote, uint64_t cache_ns_avg, uint64_t disk_ns_avg, uint64_t rdma_ns_avg)
+uint64_t CostBenefitAnalyzer::calculate_performance(uint64_t water_mark_local, uint64_t water_mark_remote, uint64_t cache_ns_avg, uint64_t disk_ns_avg, uint64_t rdma_ns_avg) const
 {
     uint64_t total_local = get_sum_freq_till_index(0, water_mark_local);
     uint64_t total_remote = get_sum_freq_till_index(water_mark_local, water_mark_local + water_mark_remote);
-    uint64_t total_disk = get_sum_freq_till_index(water_mark_local + water_mark_remote, c_sum.size());
+    uint64_t total_disk = get_sum_freq_till_index(water_mark_local + water_mark_remote, access_frequencies.size());
     uint64_t latency = (total_local * cache_ns_avg) + (((2 * total_remote / 3) * rdma_ns_avg) + (total_remote / 3 * cache_ns_avg)) + (total_disk * disk_ns_avg);
     return latency ? std::numeric_limits<uint64_t>::max() / latency : 0;
 }
 
+uint64_t CostBenefitAnalyzer::performanceAt(uint64_t local) const
+{
+    return calculate_performance(local, cache_size - (3 * local), latency_local, latency_disk, latency_rdma);
+}
+
+// Best candidate in [first, last]; ties go to the smallest local, as in a
+// sequential scan that only replaces the best on a strict improvement
+CostBenefitAnalyzer::Candidate CostBenefitAnalyzer::scanCandidates(uint64_t first, uint64_t last) const
+{
+    uint64_t count = last - first + 1;
+    uint64_t num_threads = std::max<uint64_t>(1, std::min<uint64_t>(std::thread::hardware_concurrency(), count / MIN_SCAN_PER_THREAD));
+    uint64_t per_thread = (count + num_threads - 1) / num_threads;
+    std::vector<Candidate> best(num_threads);
+
+    auto scan = [&](uint64_t t)
+    {
+        uint64_t begin = first + t * per_thread;
+        uint64_t end = std::min(last + 1, begin + per_thread);
+        Candidate candidate{0, begin};
+        for (uint64_t local = begin; local < end; local++)
+        {
+            uint64_t performance = performanceAt(local);
+            if (performance > candidate.performance)
+                candidate = {performance, local};
+        }
+        best[t] = candidate;
+    };
+    std::vector<std::thread> threads;
+    for (uint64_t t = 1; t < num_threads; ++t)
+        threads.emplace_back(scan, t);
+    scan(0);
+    for (auto &thread : threads)
+        thread.join();
+
+    Candidate result = best[0];
+    for (const Candidate &candidate : best)
+    {
+        if (candidate.performance > result.performance)
+            result = candidate;
+    }
+    return result;
+}
+
+// Latency is a*P(local) + b*P(C - 2*local) + const with a, b <= 0 and the
+// frequency prefix sum P concave, so it is convex in local and performance is
+// unimodal. Integer rounding and the clamping in get_sum_freq_till_index make
+// it only nearly so; candidates where those dominate (local 0 and any remote
+// range running past the ranking) are scanned, and so is a window around the
+// ternary search result.
+CostBenefitAnalyzer::Candidate CostBenefitAnalyzer::searchCandidates(uint64_t last) const
+{
+    uint64_t size = access_frequencies.size();
+    uint64_t first_regular = cache_size >= size ? (cache_size - size) / 2 + 1 : 1;
+    if (first_regular + 2 * SEARCH_VERIFY_WINDOW >= last)
+        return scanCandidates(0, last);
+
+    Candidate result = scanCandidates(0, first_regular - 1);
+    uint64_t lo = first_regular, hi = last;
+    while (hi - lo > SEARCH_VERIFY_WINDOW)
+    {
+        uint64_t m1 = lo + (hi - lo) / 3;
+        uint64_t m2 = hi - (hi - lo) / 3;
+        if (performanceAt(m1) < performanceAt(m2))
+            lo = m1 + 1;
+        else
+            hi = m2;
+    }
+
+    uint64_t window_first = std::max(first_regular, lo - std::min(lo, SEARCH_VERIFY_WINDOW));
+    uint64_t window_last = std::min(last, hi + SEARCH_VERIFY_WINDOW);
+    Candidate window = scanCandidates(window_first, window_last);
+    if (window.performance > result.performance)
+        result = window;
+    return result;
+}
+
 uint64_t CostBenefitAnalyzer::find_optimal_access_rates()
 {
     uint64_t best_performance = 0, best_local = 0, best_remote = cache_size;
-    for (uint64_t local = 0; local < c_sum.size(); local++)
+    if (access_frequencies.size() > 0)
     {
-        uint64_t remote = cache_size - (3 * local);
-        if (remote < 0 || local > cache_size / 3)
-            break;
-        uint64_t performance = calculate_performance(local, remote, latency_local, latency_disk, latency_rdma);
-        // if (local % 10000 == 0)
-        //     std::cout << "Local: " << local << ", Remote: " << remote << ", Performance: " << performance << std::endl;
-        if (performance > best_performance)
+        uint64_t last = std::min(access_frequencies.size() - 1, cache_size / 3);
+        Candidate best = optimizer == RedundancyOptimizer::Search ? searchCandidates(last) : scanCandidates(0, last);
+        if (best.performance > 0)
         {
-            best_performance = performance;
-            best_local = local;
-            best_remote = remote;
+            best_performance = best.performance;
+            best_local = best.local;
+            best_remote = cache_size - (3 * best_local);
         }
     }
     std::cout << "Best local: " << best_local << ", Best remote: " << best_remote << ", Best performance: " << best_performance << std::endl;
     R_opt = best_local;
-    // if (R_opt == 1)
-    // {
-    //     update_dup_keys_map();
-    //     print_cdf_to_file();
-    //     std::cout << "Optimal redundancy level: " << R_opt << " exiting to debug" << std::endl;
-    //     exit(0);
-    // }
-    update_dup_keys_map();
     return R_opt;
 }
 
 void CostBenefitAnalyzer::print_cdf_to_file()
 {
+    std::vector<int> keys = access_frequencies.topKeys(access_frequencies.accessedKeys());
     std::ofstream file("hotspot_cdf.txt");
-    for (const auto &kv : c_sum)
+    for (uint64_t i = 0; i < keys.size(); ++i)
     {
-        file << kv.first << " " << kv.second << std::endl;
+        file << keys[i] << " " << access_frequencies.prefixSum(i + 1) << std::endl;
     }
     file.close();
     std::ofstream file2("access_frequencies.txt");
-    for (const auto &kv : access_frequencies)
+    for (uint64_t i = 0; i < keys.size(); ++i)
     {
-        file2 << kv.first << " " << kv.second << std::endl;
+        file2 << access_frequencies.frequencyAt(i) << " " << keys[i] << std::endl;
     }
     file2.close();
 
+    std::vector<int> replicated_keys = getReplicatedKeys();
+    std::sort(replicated_keys.begin(), replicated_keys.end());
     std::ofstream file3("dup_keys_map.txt");
-    for (const auto &kv : dup_keys_map)
+    for (int key : replicated_keys)
     {
-        file3 << kv.first << " " << kv.second << std::endl;
+        file3 << key << " " << 1 << std::endl;
     }
     file3.close();
     std::cout << completed_requests << " requests completed\n";
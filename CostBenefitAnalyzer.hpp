@@ -1,6 +1,7 @@
 #ifndef COST_BENEFIT_ANALYZER_HPP
 #define COST_BENEFIT_ANALYZER_HPP
 
+#include "FrequencyTable.hpp"
 #include <vector>
 #include <tuple>
 #include <map>
@@ -14,49 +15,57 @@
 #include <atomic>
 #include <string>
 
+// How find_optimal_access_rates searches the local watermark
+enum class RedundancyOptimizer
+{
+    Scan,   // every candidate, split across threads
+    Search, // ternary search on the convex latency curve, then a scanned window
+};
+
 class CostBenefitAnalyzer
 {
 private:
+    struct Candidate
+    {
+        uint64_t performance = 0;
+        uint64_t local = 0;
+    };
+
+    // Candidates below this per thread are scanned on the calling thread
+    static constexpr uint64_t MIN_SCAN_PER_THREAD = 1 << 14;
+    // Candidates on each side of the ternary search result that are scanned
+    static constexpr uint64_t SEARCH_VERIFY_WINDOW = 4096;
+
     uint64_t num_replicas;
     uint64_t total_dataset_size;
     uint64_t cache_size;
 
-    std::vector<std::pair<uint64_t, uint64_t>> access_frequencies;
-    std::vector<std::pair<uint64_t, uint64_t>> c_sum;
+    FrequencyRanking access_frequencies;
     uint64_t latency_local;
     uint64_t latency_rdma;
     uint64_t latency_disk;
     uint64_t R_opt;
+    RedundancyOptimizer optimizer;
 
-    static constexpr uint64_t NUM_THREADS = 80;
-    std::mutex result_mutex;
-    std::atomic<double> best_performance;
-
-    std::map<int, bool> dup_keys_map;
-
-    static void computeOptimalRedundancyThread(const std::pair<uint64_t, uint64_t> *access_ptr,
-                                               uint64_t start_R, uint64_t end_R, uint64_t C, uint64_t N, uint64_t D,
-                                               uint64_t latency_local, uint64_t latency_rdma, uint64_t latency_disk,
-                                               std::atomic<uint64_t> &best_R, std::atomic<double> &best_performance,
-                                               std::mutex &result_mutex);
+    uint64_t performanceAt(uint64_t local) const;
+    Candidate scanCandidates(uint64_t first, uint64_t last) const;
+    Candidate searchCandidates(uint64_t last) const;
 
 public:
     CostBenefitAnalyzer(uint64_t num_replicas, uint64_t total_dataset_size, uint64_t cache_size,
-                        uint64_t latency_local, uint64_t latency_rdma, uint64_t latency_disk);
+                        uint64_t latency_local, uint64_t latency_rdma, uint64_t latency_disk,
+                        RedundancyOptimizer optimizer = RedundancyOptimizer::Scan);
 
-    void updateAccessFrequencies(const std::vector<std::pair<uint64_t, uint64_t>> &new_frequencies);
-    bool shouldCacheLocally(const std::string &key);
+    void updateAccessFrequencies(FrequencyRanking new_frequencies);
     uint64_t getOptimalRedundancy() const;
-    void update_dup_keys_map();
-    void sum_cdf();
-    uint64_t get_sum_freq_till_index(uint64_t start, uint64_t end);
-    uint64_t calculate_performance(uint64_t water_mark_local, uint64_t water_mark_remote, uint64_t cache_ns_avg, uint64_t disk_ns_avg, uint64_t rdma_ns_avg);
+    std::vector<int> getReplicatedKeys() const;
+    uint64_t get_sum_freq_till_index(uint64_t start, uint64_t end) const;
+    uint64_t calculate_performance(uint64_t water_mark_local, uint64_t water_mark_remote, uint64_t cache_ns_avg, uint64_t disk_ns_avg, uint64_t rdma_ns_avg) const;
     uint64_t find_optimal_access_rates();
     void print_cdf_to_file();
     void reset()
     {
         R_opt = 0;
-        best_performance = std::numeric_limits<double>::lowest();
     }
 };
 
@@ -0,0 +1,84 @@
+#ifndef FLAT_KEY_INDEX_HPP
+#define FLAT_KEY_INDEX_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// Fixed-size open-addressing (linear probing) map from int keys to a 32-bit
+// payload, shared by the flat cache engines. Sized once for the maximum number
+// of live keys; deletion uses backward shifting so there are no tombstones.
+class FlatKeyIndex
+{
+public:
+    static constexpr uint32_t EMPTY = UINT32_MAX;
+
+    struct Slot
+    {
+        int key;
+        uint32_t value; // EMPTY when the slot is unused
+    };
+
+    explicit FlatKeyIndex(size_t max_keys)
+    {
+        // Keep the load factor at or below 2/3
+        size_t table_size = 2;
+        shift = 63;
+        while (table_size < max_keys + max_keys / 2)
+        {
+            table_size <<= 1;
+            shift--;
+        }
+        slots.assign(table_size, Slot{0, EMPTY});
+        mask = table_size - 1;
+    }
+
+    size_t home(int key) const
+    {
+        // Fibonacci hashing: take the high bits of a 64-bit multiplicative hash
+        return static_cast<size_t>((static_cast<uint64_t>(static_cast<uint32_t>(key)) * 0x9E3779B97F4A7C15ull) >> shift);
+    }
+
+    // Slot holding key, or the empty slot where it would be inserted
+    size_t find(int key) const
+    {
+        size_t slot = home(key);
+        while (slots[slot].value != EMPTY && slots[slot].key != key)
+        {
+            slot = (slot + 1) & mask;
+        }
+        return slot;
+    }
+
+    void prefetch(int key) const
+    {
+        __builtin_prefetch(&slots[home(key)]);
+    }
+
+    Slot &operator[](size_t slot) { return slots[slot]; }
+    const Slot &operator[](size_t slot) const { return slots[slot]; }
+
+    void erase(size_t slot)
+    {
+        size_t hole = slot;
+        size_t next = (hole + 1) & mask;
+        while (slots[next].value != EMPTY)
+        {
+            size_t h = home(slots[next].key);
+            if (((next - h) & mask) >= ((next - hole) & mask))
+            {
+                slots[hole] = slots[next];
+                hole = next;
+            }
+            next = (next + 1) & mask;
+        }
+        slots[hole].value = EMPTY;
+    }
+
+private:
+    std::vector<Slot> slots;
+    size_t mask;
+    int shift;
+};
+
+#endif // FLAT_KEY_INDEX_HPP
@@ -0,0 +1,141 @@
+#include "FlatLRUCache.hpp"
+
+FlatLRUCache::FlatLRUCache(size_t cap, bool key_only)
+    : capacity(cap), key_only(key_only), entries(cap), index(cap)
+{
+    if (!key_only)
+    {
+        values.resize(cap);
+    }
+}
+
+void FlatLRUCache::unlink(uint32_t e)
+{
+    Entry &entry = entries[e];
+    if (entry.prev != NIL)
+        entries[entry.prev].next = entry.next;
+    else
+        head = entry.next;
+
+    if (entry.next != NIL)
+        entries[entry.next].prev = entry.prev;
+    else
+        tail = entry.prev;
+}
+
+void FlatLRUCache::pushFront(uint32_t e)
+{
+    entries[e].prev = NIL;
+    entries[e].next = head;
+    if (head != NIL)
+        entries[head].prev = e;
+    head = e;
+    if (tail == NIL)
+        tail = e;
+}
+
+uint32_t FlatLRUCache::allocateEntry()
+{
+    if (free_list != NIL)
+    {
+        uint32_t e = free_list;
+        free_list = entries[e].next;
+        return e;
+    }
+    return used++;
+}
+
+int FlatLRUCache::get(int key)
+{
+    size_t slot = index.find(key);
+    uint32_t e = index[slot].value;
+    if (e == NIL)
+        return -1;
+
+    if (e != head)
+    {
+        unlink(e);
+        pushFront(e);
+    }
+    return key_only ? key : values[e];
+}
+
+void FlatLRUCache::put(int key, int value)
+{
+    if (capacity == 0)
+    {
+        evicted(key);
+        return;
+    }
+
+    size_t slot = index.find(key);
+    uint32_t e = index[slot].value;
+    if (e != NIL)
+    {
+        if (e != head)
+        {
+            unlink(e);
+            pushFront(e);
+        }
+        if (!key_only)
+            values[e] = value;
+        return;
+    }
+
+    if (count >= capacity)
+    {
+        // Reuse the LRU entry in place for the new key
+        e = tail;
+        index.erase(index.find(entries[e].key));
+        unlink(e);
+        count--;
+        evicted(entries[e].key);
+        slot = index.find(key);
+    }
+    else
+    {
+        e = allocateEntry();
+    }
+
+    entries[e].key = key;
+    if (!key_only)
+        values[e] = value;
+    pushFront(e);
+    index[slot] = FlatKeyIndex::Slot{key, e};
+    count++;
+}
+
+size_t FlatLRUCache::size()
+{
+    return count;
+}
+
+std::set<int> FlatLRUCache::getKeys()
+{
+    std::set<int> keys;
+    for (uint32_t e = head; e != NIL; e = entries[e].next)
+    {
+        keys.insert(entries[e].key);
+    }
+    return keys;
+}
+
+bool FlatLRUCache::contains(int key)
+{
+    return index[index.find(key)].value != NIL;
+}
+
+void FlatLRUCache::remove(int key)
+{
+    size_t slot = index.find(key);
+    uint32_t e = index[slot].value;
+    if (e == NIL)
+        return;
+
+    index.erase(slot);
+    unlink(e);
+    entries[e].next = free_list;
+    free_list = e;
+    count--;
+    evicted(key);
+}
@@ -0,0 +1,56 @@
+#ifndef FLAT_LRU_CACHE_HPP
+#define FLAT_LRU_CACHE_HPP
+
+#include "CacheBase.hpp"
+#include "FlatKeyIndex.hpp"
+#include <cstdint>
+#include <vector>
+#include <set>
+
+// LRU cache that keeps all entries in one preallocated array linked by 32-bit
+// prev/next indices, with a FlatKeyIndex sized once from the capacity. No
+// allocation happens after construction.
+//
+// In key-only mode the value column is not stored and get() returns the key on
+// a hit, which is all ReplicaManager needs since it always calls put(key, key).
+//
+// Not internally synchronized: ReplicaManager serializes access to its replicas.
+class FlatLRUCache final : public CacheBase
+{
+private:
+    static constexpr uint32_t NIL = FlatKeyIndex::EMPTY;
+
+    struct Entry
+    {
+        int key;
+        uint32_t prev;
+        uint32_t next;
+    };
+
+    size_t capacity;
+    bool key_only;
+    std::vector<Entry> entries;
+    std::vector<int> values;
+    FlatKeyIndex index;
+    uint32_t head = NIL;
+    uint32_t tail = NIL;
+    uint32_t free_list = NIL;
+    uint32_t used = 0;
+    size_t count = 0;
+
+    void unlink(uint32_t e);
+    void pushFront(uint32_t e);
+    uint32_t allocateEntry();
+
+public:
+    FlatLRUCache(size_t cap, bool key_only = true);
+    int get(int key) override;
+    void put(int key, int value) override;
+    size_t size() override;
+    std::set<int> getKeys() override;
+    bool contains(int key) override;
+    void remove(int key) override;
+    void prefetch(int key) const override { index.prefetch(key); }
+};
+
+#endif // FLAT_LRU_CACHE_HPP
@@ -0,0 +1,161 @@
+#include "FrequencySketch.hpp"
+#include <algorithm>
+#include <cmath>
+
+CountMinSketch::CountMinSketch(uint32_t depth, uint64_t width)
+    : depth(depth), width(1), shift(64)
+{
+    // Largest power of two that fits
+    while (this->width * 2 <= width)
+    {
+        this->width <<= 1;
+        shift--;
+    }
+    counters.reset(new std::atomic<uint32_t>[depth * this->width]);
+    reset();
+}
+
+void CountMinSketch::reset()
+{
+    for (uint64_t i = 0; i < depth * width; ++i)
+        counters[i].store(0, std::memory_order_relaxed);
+}
+
+double CountMinSketch::epsilon() const
+{
+    return std::exp(1.0) / width;
+}
+
+double CountMinSketch::delta() const
+{
+    return std::exp(-static_cast<double>(depth));
+}
+
+HeavyHitters::HeavyHitters(size_t capacity)
+    : capacity(capacity), index(capacity), keys(capacity), counts(capacity), heap_pos(capacity)
+{
+    heap.reserve(capacity);
+}
+
+uint64_t HeavyHitters::bytesPerKey()
+{
+    // Index slots at up to 3x the keys, plus key, count and both heap arrays
+    return 3 * sizeof(FlatKeyIndex::Slot) + sizeof(int) + 3 * sizeof(uint32_t);
+}
+
+uint64_t HeavyHitters::memoryBytes() const
+{
+    return capacity * bytesPerKey();
+}
+
+void HeavyHitters::siftUp(size_t pos)
+{
+    uint32_t slot = heap[pos];
+    while (pos > 0)
+    {
+        size_t parent = (pos - 1) / 2;
+        if (counts[heap[parent]] <= counts[slot])
+            break;
+        heap[pos] = heap[parent];
+        heap_pos[heap[pos]] = pos;
+        pos = parent;
+    }
+    heap[pos] = slot;
+    heap_pos[slot] = pos;
+}
+
+void HeavyHitters::siftDown(size_t pos)
+{
+    uint32_t slot = heap[pos];
+    while (true)
+    {
+        size_t child = 2 * pos + 1;
+        if (child >= heap.size())
+            break;
+        if (child + 1 < heap.size() && counts[heap[child + 1]] < counts[heap[child]])
+            child++;
+        if (counts[slot] <= counts[heap[child]])
+            break;
+        heap[pos] = heap[child];
+        heap_pos[heap[pos]] = pos;
+        pos = child;
+    }
+    heap[pos] = slot;
+    heap_pos[slot] = pos;
+}
+
+void HeavyHitters::offer(int key, uint32_t estimate)
+{
+    if (capacity == 0)
+        return;
+    size_t pos = index.find(key);
+    if (index[pos].value != FlatKeyIndex::EMPTY)
+    {
+        uint32_t slot = index[pos].value;
+        if (estimate > counts[slot])
+        {
+            counts[slot] = estimate;
+            siftDown(heap_pos[slot]);
+        }
+        return;
+    }
+
+    uint32_t slot;
+    if (heap.size() < capacity)
+    {
+        slot = static_cast<uint32_t>(heap.size());
+        heap.push_back(slot);
+        keys[slot] = key;
+        counts[slot] = estimate;
+        index[pos] = {key, slot};
+        siftUp(heap.size() - 1);
+        return;
+    }
+
+    // Replace the coldest monitored key
+    slot = heap[0];
+    if (estimate <= counts[slot])
+        return;
+    index.erase(index.find(keys[slot]));
+    index[index.find(key)] = {key, slot};
+    keys[slot] = key;
+    counts[slot] = estimate;
+    siftDown(0);
+}
+
+std::vector<std::pair<uint32_t, int>> HeavyHitters::take()
+{
+    std::vector<std::pair<uint32_t, int>> monitored;
+    monitored.reserve(heap.size());
+    for (uint32_t slot : heap)
+    {
+        monitored.emplace_back(counts[slot], keys[slot]);
+        index.erase(index.find(keys[slot]));
+    }
+    heap.clear();
+    return monitored;
+}
+
+FrequencySketch::FrequencySketch(uint64_t memory_bytes, uint64_t top_k)
+    : sketch(DEPTH, std::max<uint64_t>(MIN_WIDTH, (memory_bytes - std::min(memory_bytes, top_k * HeavyHitters::bytesPerKey())) / (DEPTH * sizeof(uint32_t)))),
+      head(top_k)
+{
+}
+
+std::vector<std::pair<uint32_t, int>> FrequencySketch::take(uint64_t &requests)
+{
+    std::vector<std::pair<uint32_t, int>> monitored;
+    {
+        std::lock_guard<std::mutex> lock(head_mutex);
+        monitored = head.take();
+        head_threshold.store(0, std::memory_order_relaxed);
+    }
+    sketch.reset();
+    requests = total_requests.exchange(0, std::memory_order_relaxed);
+    return monitored;
+}
+
+uint64_t FrequencySketch::memoryBytes() const
+{
+    return sketch.memoryBytes() + head.memoryBytes();
+}
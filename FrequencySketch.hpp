@@ -0,0 +1,136 @@
+#ifndef FREQUENCY_SKETCH_HPP
+#define FREQUENCY_SKETCH_HPP
+
+#include "FlatKeyIndex.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Count-min sketch of depth rows by width (a power of two) 32-bit counters.
+// An estimate never undercounts and, with probability 1 - e^-depth,
+// overcounts by at most e / width times the number of recorded requests.
+class CountMinSketch
+{
+private:
+    std::unique_ptr<std::atomic<uint32_t>[]> counters;
+    uint32_t depth;
+    uint64_t width;
+    int shift;
+
+    size_t counterIndex(uint32_t row, int key) const
+    {
+        uint64_t h = (static_cast<uint64_t>(static_cast<uint32_t>(key)) + (row + 1) * 0x9E3779B97F4A7C15ull) * 0xBF58476D1CE4E5B9ull;
+        h ^= h >> 31;
+        h *= 0x94D049BB133111EBull;
+        return row * width + (h >> shift);
+    }
+
+public:
+    CountMinSketch(uint32_t depth, uint64_t width);
+
+    // Adds one access and returns the key's new estimate
+    template <bool Concurrent>
+    uint32_t add(int key)
+    {
+        uint32_t estimate = UINT32_MAX;
+        for (uint32_t row = 0; row < depth; ++row)
+        {
+            std::atomic<uint32_t> &counter = counters[counterIndex(row, key)];
+            uint32_t count;
+            if constexpr (Concurrent)
+            {
+                count = counter.fetch_add(1, std::memory_order_relaxed) + 1;
+            }
+            else
+            {
+                count = counter.load(std::memory_order_relaxed) + 1;
+                counter.store(count, std::memory_order_relaxed);
+            }
+            estimate = std::min(estimate, count);
+        }
+        return estimate;
+    }
+
+    void reset();
+    double epsilon() const;
+    double delta() const;
+    uint64_t memoryBytes() const { return depth * width * sizeof(uint32_t); }
+};
+
+// The capacity keys with the highest estimates, kept in a min-heap so the
+// coldest monitored key is replaced in O(log capacity)
+class HeavyHitters
+{
+private:
+    size_t capacity;
+    FlatKeyIndex index; // key -> slot
+    std::vector<int> keys;
+    std::vector<uint32_t> counts;
+    std::vector<uint32_t> heap;     // slots, min count first
+    std::vector<uint32_t> heap_pos; // slot -> position in heap
+
+    void siftUp(size_t pos);
+    void siftDown(size_t pos);
+
+public:
+    explicit HeavyHitters(size_t capacity);
+
+    void offer(int key, uint32_t estimate);
+    // Smallest estimate a new key must beat, 0 while there is room
+    uint32_t admissionThreshold() const { return heap.size() < capacity ? 0 : counts[heap[0]] + 1; }
+    // Monitored (estimate, key) pairs; empties the table
+    std::vector<std::pair<uint32_t, int>> take();
+    static uint64_t bytesPerKey();
+    uint64_t memoryBytes() const;
+};
+
+// Approximate per-interval access counts in fixed memory, for key spaces too
+// large to count exactly. The count-min sketch holds the frequency mass and a
+// heavy-hitter table the hot head R_opt is chosen from; the remaining mass is
+// spread over the rest of the dataset as an anonymous tail.
+class FrequencySketch
+{
+private:
+    static constexpr uint32_t DEPTH = 4;
+    static constexpr uint64_t MIN_WIDTH = 1024;
+
+    CountMinSketch sketch;
+    HeavyHitters head;
+    std::mutex head_mutex;
+    std::atomic<uint32_t> head_threshold{0};
+    std::atomic<uint64_t> total_requests{0};
+
+public:
+    FrequencySketch(uint64_t memory_bytes, uint64_t top_k);
+
+    template <bool Concurrent>
+    void record(int key)
+    {
+        if constexpr (Concurrent)
+            total_requests.fetch_add(1, std::memory_order_relaxed);
+        else
+            total_requests.store(total_requests.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+        uint32_t estimate = sketch.add<Concurrent>(key);
+        if (estimate < head_threshold.load(std::memory_order_relaxed))
+            return;
+        std::unique_lock<std::mutex> lock(head_mutex, std::defer_lock);
+        if constexpr (Concurrent)
+            lock.lock();
+        head.offer(key, estimate);
+        head_threshold.store(head.admissionThreshold(), std::memory_order_relaxed);
+    }
+
+    // Hot head and request count since the last take; resets the sketch
+    std::vector<std::pair<uint32_t, int>> take(uint64_t &requests);
+    double epsilon() const { return sketch.epsilon(); }
+    double delta() const { return sketch.delta(); }
+    uint64_t memoryBytes() const;
+};
+
+#endif // FREQUENCY_SKETCH_HPP
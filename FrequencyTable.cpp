@@ -0,0 +1,298 @@
+#include "FrequencyTable.hpp"
+#include <algorithm>
+#include <functional>
+#include <thread>
+
+namespace
+{
+    struct KeyCount
+    {
+        uint32_t count;
+        int key;
+    };
+
+    constexpr int RADIX_BITS = 8;
+    constexpr size_t RADIX_BUCKETS = 1 << RADIX_BITS;
+    // Below this many keys per thread the scan and sort stay single-threaded
+    constexpr size_t MIN_KEYS_PER_THREAD = 1 << 16;
+
+    template <typename F>
+    void parallelFor(size_t num_threads, F &&f)
+    {
+        std::vector<std::thread> threads;
+        for (size_t t = 1; t < num_threads; ++t)
+            threads.emplace_back(std::ref(f), t);
+        f(0);
+        for (auto &thread : threads)
+            thread.join();
+    }
+
+    // Stable LSD radix sort by count, descending. Each pass histograms its
+    // digit per thread-contiguous segment, so the scatter keeps input order
+    // within a bucket and the overall sort stays stable.
+    void sortByCountDescending(std::vector<KeyCount> &items, size_t num_threads)
+    {
+        uint32_t max_count = 0;
+        for (const KeyCount &item : items)
+            max_count = std::max(max_count, item.count);
+
+        num_threads = std::max<size_t>(1, std::min(num_threads, items.size() / MIN_KEYS_PER_THREAD));
+        std::vector<KeyCount> buffer(items.size());
+        std::vector<size_t> offsets(num_threads * RADIX_BUCKETS);
+        size_t segment = (items.size() + num_threads - 1) / num_threads;
+
+        for (int shift = 0; shift < 32 && (max_count >> shift) != 0; shift += RADIX_BITS)
+        {
+            auto digit = [shift](const KeyCount &item)
+            {
+                return RADIX_BUCKETS - 1 - ((item.count >> shift) & (RADIX_BUCKETS - 1));
+            };
+
+            std::fill(offsets.begin(), offsets.end(), 0);
+            parallelFor(num_threads, [&](size_t t)
+                        {
+                size_t *histogram = &offsets[t * RADIX_BUCKETS];
+                size_t end = std::min(items.size(), (t + 1) * segment);
+                for (size_t i = t * segment; i < end; ++i)
+                    histogram[digit(items[i])]++; });
+
+            // Bucket-major, thread-minor prefix sum
+            size_t position = 0;
+            for (size_t b = 0; b < RADIX_BUCKETS; ++b)
+            {
+                for (size_t t = 0; t < num_threads; ++t)
+                {
+                    size_t count = offsets[t * RADIX_BUCKETS + b];
+                    offsets[t * RADIX_BUCKETS + b] = position;
+                    position += count;
+                }
+            }
+
+            parallelFor(num_threads, [&](size_t t)
+                        {
+                size_t *next = &offsets[t * RADIX_BUCKETS];
+                size_t end = std::min(items.size(), (t + 1) * segment);
+                for (size_t i = t * segment; i < end; ++i)
+                    buffer[next[digit(items[i])]++] = items[i]; });
+            items.swap(buffer);
+        }
+    }
+}
+
+uint64_t FrequencyRanking::prefixSum(uint64_t n) const
+{
+    n = std::min(n, total_keys);
+    size_t g = std::upper_bound(group_end.begin(), group_end.end(), n) - group_end.begin();
+    if (g == group_end.size())
+        return group_sum.empty() ? 0 : group_sum.back();
+    uint64_t group_start = g ? group_end[g - 1] : 0;
+    uint64_t sum_before = g ? group_sum[g - 1] : 0;
+    return sum_before + (n - group_start) * group_frequency[g];
+}
+
+uint64_t FrequencyRanking::frequencyAt(uint64_t rank) const
+{
+    size_t g = std::upper_bound(group_end.begin(), group_end.end(), rank) - group_end.begin();
+    return g < group_frequency.size() ? group_frequency[g] : 0;
+}
+
+std::vector<int> FrequencyRanking::topKeys(uint64_t n) const
+{
+    return std::vector<int>(keys.begin(), keys.begin() + std::min<uint64_t>(n, keys.size()));
+}
+
+FrequencyTable::FrequencyTable(uint64_t dataset_size)
+    : counts(new std::atomic<uint32_t>[dataset_size + 1]), range(dataset_size + 1), dataset_size(dataset_size)
+{
+    for (size_t key = 0; key < range; ++key)
+        counts[key].store(0, std::memory_order_relaxed);
+}
+
+FrequencyTable::FrequencyTable(uint64_t dataset_size, uint64_t sketch_memory_bytes, uint64_t sketch_top_k)
+    : range(0), dataset_size(dataset_size), sketch(std::make_unique<FrequencySketch>(sketch_memory_bytes, sketch_top_k))
+{
+}
+
+FrequencyTable::FrequencyTable(uint64_t dataset_size, uint64_t half_life)
+    : range(0), dataset_size(dataset_size), hot_set(std::make_unique<HotSet>(dataset_size, half_life))
+{
+}
+
+// The hot set is already in rank order, so this is a copy with no sort. Ties
+// rank in the order their keys reached the count.
+FrequencyRanking FrequencyTable::snapshotHotSet()
+{
+    FrequencyRanking ranking;
+    ranking.dataset_size = dataset_size;
+    uint64_t sum = 0;
+    uint64_t in_dataset = hot_set->visit([&](int key, uint64_t count)
+                                         {
+        if (!ranking.group_frequency.empty() && ranking.group_frequency.back() == count)
+        {
+            ranking.group_end.back()++;
+            ranking.group_sum.back() += count;
+        }
+        else
+        {
+            ranking.group_frequency.push_back(count);
+            ranking.group_end.push_back(ranking.keys.size() + 1);
+            ranking.group_sum.push_back(sum + count);
+        }
+        ranking.keys.push_back(key);
+        sum += count; });
+
+    uint64_t never_accessed = dataset_size - in_dataset;
+    ranking.total_keys = ranking.keys.size() + never_accessed;
+    if (never_accessed > 0)
+    {
+        ranking.group_frequency.push_back(0);
+        ranking.group_end.push_back(ranking.total_keys);
+        ranking.group_sum.push_back(sum);
+    }
+    return ranking;
+}
+
+// Ranks the monitored head by estimate and lets one or two flat groups stand
+// in for the remaining keys of [1, dataset_size], so prefix sums still add up
+// to the number of requests recorded.
+FrequencyRanking FrequencyTable::drainSketch(unsigned num_threads)
+{
+    uint64_t requests = 0;
+    std::vector<std::pair<uint32_t, int>> monitored = sketch->take(requests);
+    std::vector<KeyCount> items;
+    items.reserve(monitored.size());
+    for (const auto &[count, key] : monitored)
+        items.push_back({count, key});
+    std::vector<std::pair<uint32_t, int>>().swap(monitored);
+    std::sort(items.begin(), items.end(), [](const KeyCount &a, const KeyCount &b)
+              { return a.key > b.key; });
+    sortByCountDescending(items, num_threads);
+
+    FrequencyRanking ranking;
+    ranking.dataset_size = dataset_size;
+    ranking.estimate_error = sketch->epsilon() * requests;
+    ranking.error_probability = sketch->delta();
+    ranking.keys.reserve(items.size());
+    uint64_t sum = 0, in_dataset = 0;
+    for (size_t i = 0; i < items.size(); ++i)
+    {
+        ranking.keys.push_back(items[i].key);
+        sum += items[i].count;
+        if (items[i].key > 0 && static_cast<uint64_t>(items[i].key) <= dataset_size)
+            in_dataset++;
+        if (i + 1 == items.size() || items[i + 1].count != items[i].count)
+        {
+            ranking.group_frequency.push_back(items[i].count);
+            ranking.group_end.push_back(i + 1);
+            ranking.group_sum.push_back(sum);
+        }
+    }
+
+    uint64_t tail_keys = dataset_size - std::min(dataset_size, in_dataset);
+    uint64_t tail_mass = requests > sum ? requests - sum : 0;
+    ranking.total_keys = items.size() + tail_keys;
+    if (tail_keys > 0)
+    {
+        uint64_t frequency = tail_mass / tail_keys;
+        uint64_t above = tail_mass % tail_keys;
+        if (above > 0)
+        {
+            sum += above * (frequency + 1);
+            ranking.group_frequency.push_back(frequency + 1);
+            ranking.group_end.push_back(items.size() + above);
+            ranking.group_sum.push_back(sum);
+        }
+        sum += (tail_keys - above) * frequency;
+        ranking.group_frequency.push_back(frequency);
+        ranking.group_end.push_back(ranking.total_keys);
+        ranking.group_sum.push_back(sum);
+    }
+    return ranking;
+}
+
+FrequencyRanking FrequencyTable::drain(unsigned num_threads, bool concurrent)
+{
+    if (sketch)
+        return drainSketch(num_threads);
+    if (hot_set)
+        return snapshotHotSet();
+
+    size_t scan_threads = std::max<size_t>(1, std::min<size_t>(num_threads, range / MIN_KEYS_PER_THREAD));
+    size_t segment = (range + scan_threads - 1) / scan_threads;
+
+    // Thread t takes the t-th highest key segment and walks it downwards, so
+    // concatenating the results in thread order lists keys in descending order
+    std::vector<std::vector<KeyCount>> accessed(scan_threads);
+    std::vector<uint64_t> accessed_in_dataset(scan_threads, 0);
+    parallelFor(scan_threads, [&](size_t t)
+                {
+        size_t high = range - std::min(range, t * segment);
+        size_t low = range - std::min(range, (t + 1) * segment);
+        for (size_t key = high; key-- > low;)
+        {
+            uint32_t count = concurrent ? counts[key].exchange(0, std::memory_order_relaxed)
+                                        : counts[key].load(std::memory_order_relaxed);
+            if (count == 0)
+                continue;
+            if (!concurrent)
+                counts[key].store(0, std::memory_order_relaxed);
+            accessed[t].push_back({count, static_cast<int>(key)});
+            if (key != 0)
+                accessed_in_dataset[t]++;
+        } });
+
+    std::map<int, uint64_t> overflow_counts;
+    {
+        std::lock_guard<std::mutex> lock(overflow_mutex);
+        overflow_counts.swap(overflow);
+    }
+
+    std::vector<KeyCount> items;
+    size_t total = overflow_counts.size();
+    for (const auto &keys : accessed)
+        total += keys.size();
+    items.reserve(total);
+    for (auto it = overflow_counts.rbegin(); it != overflow_counts.rend() && it->first >= 0; ++it)
+        items.push_back({static_cast<uint32_t>(std::min<uint64_t>(it->second, UINT32_MAX)), it->first});
+    for (auto &keys : accessed)
+    {
+        items.insert(items.end(), keys.begin(), keys.end());
+        std::vector<KeyCount>().swap(keys);
+    }
+    for (auto it = overflow_counts.rbegin(); it != overflow_counts.rend(); ++it)
+    {
+        if (it->first < 0)
+            items.push_back({static_cast<uint32_t>(std::min<uint64_t>(it->second, UINT32_MAX)), it->first});
+    }
+
+    sortByCountDescending(items, num_threads);
+
+    FrequencyRanking ranking;
+    ranking.dataset_size = range - 1;
+    ranking.keys.reserve(items.size());
+    uint64_t sum = 0;
+    for (size_t i = 0; i < items.size(); ++i)
+    {
+        ranking.keys.push_back(items[i].key);
+        sum += items[i].count;
+        if (i + 1 == items.size() || items[i + 1].count != items[i].count)
+        {
+            ranking.group_frequency.push_back(items[i].count);
+            ranking.group_end.push_back(i + 1);
+            ranking.group_sum.push_back(sum);
+        }
+    }
+
+    uint64_t in_dataset = 0;
+    for (uint64_t n : accessed_in_dataset)
+        in_dataset += n;
+    uint64_t never_accessed = ranking.dataset_size - in_dataset;
+    ranking.total_keys = items.size() + never_accessed;
+    if (never_accessed > 0)
+    {
+        ranking.group_frequency.push_back(0);
+        ranking.group_end.push_back(ranking.total_keys);
+        ranking.group_sum.push_back(sum);
+    }
+    return ranking;
+}
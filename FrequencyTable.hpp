@@ -0,0 +1,110 @@
+#ifndef FREQUENCY_TABLE_HPP
+#define FREQUENCY_TABLE_HPP
+
+#include "FrequencySketch.hpp"
+#include "HotSet.hpp"
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// One CBA interval's access counts ranked by frequency (descending, ties by
+// key descending), followed by the never-accessed rest of [1, dataset_size]
+// at frequency zero, which is counted but never listed. Keys of equal
+// frequency form a group, so prefix sums are stored once per distinct
+// frequency instead of once per key.
+//
+// A ranking drained from a sketch only knows its hot head: the remaining
+// mass is spread evenly over the rest of the dataset without naming keys.
+class FrequencyRanking
+{
+private:
+    std::vector<int> keys; // accessed keys in rank order
+    std::vector<uint64_t> group_frequency;
+    std::vector<uint64_t> group_end; // rank one past the group's last key
+    std::vector<uint64_t> group_sum; // accesses of all ranks before group_end
+    uint64_t dataset_size = 0;
+    uint64_t total_keys = 0;
+
+    friend class FrequencyTable;
+
+public:
+    // Ranked keys, including the never-accessed tail
+    uint64_t size() const { return total_keys; }
+    uint64_t accessedKeys() const { return keys.size(); }
+    // Accesses of the n highest ranked keys
+    uint64_t prefixSum(uint64_t n) const;
+    uint64_t frequencyAt(uint64_t rank) const;
+    // The n highest ranked keys, capped at accessedKeys(): ranks past them
+    // have no accesses to gain from replication
+    std::vector<int> topKeys(uint64_t n) const;
+
+    // Sketch error bound: each count may be overestimated by up to
+    // estimate_error accesses with probability error_probability
+    double estimate_error = 0;
+    double error_probability = 0;
+};
+
+// Dense per-key access counters for the key range [0, dataset_size]. Workers
+// bump a key's counter with a relaxed atomic add (a plain increment when the
+// caller is the only writer); keys outside the range go to a locked map.
+// In sketch mode no counters are allocated and every key goes to a
+// FrequencySketch of fixed size instead. In decayed mode keys go to a HotSet,
+// which keeps its history across drains and ages it by halving.
+class FrequencyTable
+{
+private:
+    std::unique_ptr<std::atomic<uint32_t>[]> counts;
+    size_t range;
+    uint64_t dataset_size;
+    std::mutex overflow_mutex;
+    std::map<int, uint64_t> overflow;
+    std::unique_ptr<FrequencySketch> sketch;
+    std::unique_ptr<HotSet> hot_set;
+
+    FrequencyRanking drainSketch(unsigned num_threads);
+    FrequencyRanking snapshotHotSet();
+
+public:
+    explicit FrequencyTable(uint64_t dataset_size);
+    FrequencyTable(uint64_t dataset_size, uint64_t sketch_memory_bytes, uint64_t sketch_top_k);
+    FrequencyTable(uint64_t dataset_size, uint64_t half_life);
+
+    template <bool Concurrent>
+    void record(int key)
+    {
+        if (static_cast<uint64_t>(static_cast<uint32_t>(key)) < range)
+        {
+            std::atomic<uint32_t> &count = counts[key];
+            if constexpr (Concurrent)
+                count.fetch_add(1, std::memory_order_relaxed);
+            else
+                count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return;
+        }
+        if (sketch)
+        {
+            sketch->record<Concurrent>(key);
+            return;
+        }
+        if (hot_set)
+        {
+            hot_set->record<Concurrent>(key);
+            return;
+        }
+        std::lock_guard<std::mutex> lock(overflow_mutex);
+        overflow[key]++;
+    }
+
+    // Ranks the counts recorded since the last drain and resets them. The key
+    // range is scanned and the ranking radix sorted on num_threads threads.
+    // concurrent must be set while workers may still be recording. A decayed
+    // table is only read, never reset.
+    FrequencyRanking drain(unsigned num_threads, bool concurrent);
+    bool keepsHistory() const { return hot_set != nullptr; }
+};
+
+#endif // FREQUENCY_TABLE_HPP
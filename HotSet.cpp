@@ -0,0 +1,187 @@
+#include "HotSet.hpp"
+#include <algorithm>
+
+HotSet::HotSet(uint64_t dataset_size, uint64_t half_life)
+    : key_bucket(dataset_size + 1, NONE), key_prev(dataset_size + 1, NONE), key_next(dataset_size + 1, NONE),
+      range(dataset_size + 1), half_life(std::max<uint64_t>(1, half_life)), until_decay(this->half_life)
+{
+}
+
+uint32_t HotSet::slotOf(int key)
+{
+    uint64_t k = static_cast<uint32_t>(key);
+    if (k < range)
+        return static_cast<uint32_t>(k);
+    auto [it, inserted] = outlier_slots.try_emplace(key, NONE);
+    if (inserted)
+    {
+        if (!free_slots.empty())
+        {
+            it->second = free_slots.back();
+            free_slots.pop_back();
+            outlier_keys[it->second - range] = key;
+        }
+        else
+        {
+            it->second = static_cast<uint32_t>(range + outlier_keys.size());
+            outlier_keys.push_back(key);
+            key_bucket.push_back(NONE);
+            key_prev.push_back(NONE);
+            key_next.push_back(NONE);
+        }
+    }
+    return it->second;
+}
+
+uint32_t HotSet::insertBucket(uint64_t count, uint32_t higher, uint32_t lower)
+{
+    uint32_t bucket;
+    if (!free_buckets.empty())
+    {
+        bucket = free_buckets.back();
+        free_buckets.pop_back();
+    }
+    else
+    {
+        bucket = static_cast<uint32_t>(buckets.size());
+        buckets.emplace_back();
+    }
+    buckets[bucket] = {count, 0, NONE, NONE, higher, lower};
+    if (higher != NONE)
+        buckets[higher].lower = bucket;
+    else
+        highest = bucket;
+    if (lower != NONE)
+        buckets[lower].higher = bucket;
+    else
+        lowest = bucket;
+    return bucket;
+}
+
+void HotSet::removeBucket(uint32_t bucket)
+{
+    uint32_t higher = buckets[bucket].higher, lower = buckets[bucket].lower;
+    if (higher != NONE)
+        buckets[higher].lower = lower;
+    else
+        highest = lower;
+    if (lower != NONE)
+        buckets[lower].higher = higher;
+    else
+        lowest = higher;
+    free_buckets.push_back(bucket);
+}
+
+void HotSet::pushKey(uint32_t bucket, uint32_t slot)
+{
+    Bucket &b = buckets[bucket];
+    key_bucket[slot] = bucket;
+    key_prev[slot] = b.tail;
+    key_next[slot] = NONE;
+    if (b.tail != NONE)
+        key_next[b.tail] = slot;
+    else
+        b.head = slot;
+    b.tail = slot;
+    b.size++;
+}
+
+void HotSet::removeKey(uint32_t bucket, uint32_t slot)
+{
+    Bucket &b = buckets[bucket];
+    if (key_prev[slot] != NONE)
+        key_next[key_prev[slot]] = key_next[slot];
+    else
+        b.head = key_next[slot];
+    if (key_next[slot] != NONE)
+        key_prev[key_next[slot]] = key_prev[slot];
+    else
+        b.tail = key_prev[slot];
+    b.size--;
+}
+
+void HotSet::untrack(uint32_t slot)
+{
+    key_bucket[slot] = NONE;
+    tracked--;
+    if (slot != 0 && slot < range)
+        tracked_in_dataset--;
+    // Leaves key_next alone for decay(), which is still walking the bucket
+    if (slot >= range)
+    {
+        outlier_slots.erase(outlier_keys[slot - range]);
+        free_slots.push_back(slot);
+    }
+}
+
+template <bool Concurrent>
+void HotSet::record(int key)
+{
+    std::unique_lock<std::mutex> lock(mutex, std::defer_lock);
+    if constexpr (Concurrent)
+        lock.lock();
+    uint32_t slot = slotOf(key);
+    uint32_t from = key_bucket[slot];
+    uint64_t count = from == NONE ? 1 : buckets[from].count + 1;
+    uint32_t higher = from == NONE ? lowest : buckets[from].higher;
+
+    uint32_t to = higher;
+    if (higher == NONE || buckets[higher].count != count)
+        to = insertBucket(count, higher, from);
+    if (from == NONE)
+    {
+        tracked++;
+        if (slot != 0 && slot < range)
+            tracked_in_dataset++;
+    }
+    else
+    {
+        removeKey(from, slot);
+        if (buckets[from].size == 0)
+            removeBucket(from);
+    }
+    pushKey(to, slot);
+
+    if (--until_decay == 0)
+    {
+        decay();
+        until_decay = half_life;
+    }
+}
+
+template void HotSet::record<true>(int key);
+template void HotSet::record<false>(int key);
+
+// Halves every count, walking down from the highest bucket so a bucket that
+// lands on its higher neighbour's count is appended to it
+void HotSet::decay()
+{
+    uint32_t b = highest;
+    while (b != NONE)
+    {
+        uint32_t lower = buckets[b].lower;
+        uint64_t count = buckets[b].count >> 1;
+        uint32_t higher = buckets[b].higher;
+        if (count == 0)
+        {
+            for (uint32_t slot = buckets[b].head; slot != NONE; slot = key_next[slot])
+                untrack(slot);
+            removeBucket(b);
+        }
+        else if (higher != NONE && buckets[higher].count == count)
+        {
+            for (uint32_t slot = buckets[b].head; slot != NONE; slot = key_next[slot])
+                key_bucket[slot] = higher;
+            key_next[buckets[higher].tail] = buckets[b].head;
+            key_prev[buckets[b].head] = buckets[higher].tail;
+            buckets[higher].tail = buckets[b].tail;
+            buckets[higher].size += buckets[b].size;
+            removeBucket(b);
+        }
+        else
+        {
+            buckets[b].count = count;
+        }
+        b = lower;
+    }
+}
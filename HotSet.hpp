@@ -0,0 +1,84 @@
+#ifndef HOT_SET_HPP
+#define HOT_SET_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Access counts kept in frequency order as requests arrive, so a ranking can
+// be read at any moment without a scan or sort. Keys of equal count share a
+// bucket and buckets are linked in descending count order, so an access moves
+// its key to the next bucket in O(1), as in an O(1) LFU.
+//
+// Every half_life accesses all counts are halved and keys that reach zero
+// are dropped. The order survives halving, so decay only relabels buckets and
+// merges neighbours that end up with the same count; it costs one pass over
+// the tracked keys per half-life.
+class HotSet
+{
+private:
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    struct Bucket
+    {
+        uint64_t count;
+        uint64_t size;
+        uint32_t head, tail;    // first and last key slot
+        uint32_t higher, lower; // neighbouring buckets
+    };
+
+    std::vector<Bucket> buckets;
+    std::vector<uint32_t> free_buckets;
+    uint32_t highest = NONE;
+    uint32_t lowest = NONE;
+    // Per key slot: keys of [0, dataset_size] use the key as slot, others
+    // get a slot past range on first access, freed again when decay drops
+    // the key
+    std::vector<uint32_t> key_bucket;
+    std::vector<uint32_t> key_prev;
+    std::vector<uint32_t> key_next;
+    std::unordered_map<int, uint32_t> outlier_slots;
+    std::vector<int> outlier_keys;
+    std::vector<uint32_t> free_slots;
+    uint64_t range;
+    uint64_t half_life;
+    uint64_t until_decay;
+    uint64_t tracked = 0;
+    uint64_t tracked_in_dataset = 0;
+    std::mutex mutex;
+
+    uint32_t slotOf(int key);
+    int keyOf(uint32_t slot) const { return slot < range ? static_cast<int>(slot) : outlier_keys[slot - range]; }
+    uint32_t insertBucket(uint64_t count, uint32_t higher, uint32_t lower);
+    void removeBucket(uint32_t bucket);
+    void pushKey(uint32_t bucket, uint32_t slot);
+    void removeKey(uint32_t bucket, uint32_t slot);
+    void untrack(uint32_t slot);
+    void decay();
+
+public:
+    HotSet(uint64_t dataset_size, uint64_t half_life);
+
+    // Only concurrent recorders lock; without them visit() must run on the
+    // recording thread
+    template <bool Concurrent>
+    void record(int key);
+
+    // Calls f(key, count) for every tracked key in descending count order
+    // and returns how many tracked keys lie in [1, dataset_size]
+    template <typename F>
+    uint64_t visit(F &&f)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (uint32_t b = highest; b != NONE; b = buckets[b].lower)
+        {
+            for (uint32_t slot = buckets[b].head; slot != NONE; slot = key_next[slot])
+                f(keyOf(slot), buckets[b].count);
+        }
+        return tracked_in_dataset;
+    }
+};
+
+#endif // HOT_SET_HPP
@@ -0,0 +1,68 @@
+#ifndef KEY_BITMAP_HPP
+#define KEY_BITMAP_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// A set of keys as one bit per key of [0, range), with the rare keys outside
+// that range kept in a vector. Metrics combine replicas' bitmaps a word at a
+// time instead of merging ordered sets.
+class KeyBitmap
+{
+public:
+    KeyBitmap() = default;
+    explicit KeyBitmap(uint64_t range) : range(range), words((range + 63) / 64, 0) {}
+
+    void insert(int key)
+    {
+        uint64_t k = static_cast<uint32_t>(key);
+        if (k < range)
+            words[k >> 6] |= 1ull << (k & 63);
+        else
+            outliers.push_back(key);
+    }
+
+    // Calls f(key) for every key, the dense ones in ascending order
+    template <typename F>
+    void forEach(F &&f) const
+    {
+        for (size_t w = 0; w < words.size(); ++w)
+        {
+            for (uint64_t bits = words[w]; bits; bits &= bits - 1)
+                f(static_cast<int>(w * 64 + __builtin_ctzll(bits)));
+        }
+        for (int key : outliers)
+            f(key);
+    }
+
+    uint64_t keyRange() const { return range; }
+    const std::vector<uint64_t> &bits() const { return words; }
+    // May hold duplicates
+    const std::vector<int> &outlierKeys() const { return outliers; }
+
+private:
+    uint64_t range = 0;
+    std::vector<uint64_t> words;
+    std::vector<int> outliers;
+};
+
+// Runs f(begin, end) over disjoint word ranges covering [0, num_words), on up
+// to one thread per core
+template <typename F>
+void forEachWordRange(size_t num_words, F &&f)
+{
+    static constexpr size_t MIN_WORDS_PER_THREAD = 1 << 12;
+    size_t threads = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()),
+                                      std::max<size_t>(1, num_words / MIN_WORDS_PER_THREAD));
+    std::vector<std::thread> workers;
+    for (size_t t = 1; t < threads; ++t)
+        workers.emplace_back(f, num_words * t / threads, num_words * (t + 1) / threads);
+    f(size_t(0), num_words / threads);
+    for (auto &worker : workers)
+        worker.join();
+}
+
+#endif // KEY_BITMAP_HPP
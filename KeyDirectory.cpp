@@ -0,0 +1,35 @@
+#include "KeyDirectory.hpp"
+
+KeyDirectory::KeyDirectory(uint64_t dataset_size)
+    : range(dataset_size + 1), masks(new std::atomic<uint64_t>[dataset_size + 1]())
+{
+}
+
+uint64_t KeyDirectory::insertOutlier(int key, uint64_t bit)
+{
+    std::lock_guard<std::mutex> lock(outlier_mutex);
+    uint64_t &mask = outliers[key];
+    uint64_t old = mask;
+    mask |= bit;
+    return old;
+}
+
+uint64_t KeyDirectory::eraseOutlier(int key, uint64_t bit)
+{
+    std::lock_guard<std::mutex> lock(outlier_mutex);
+    auto it = outliers.find(key);
+    if (it == outliers.end())
+        return 0;
+    uint64_t old = it->second;
+    it->second &= ~bit;
+    if (it->second == 0)
+        outliers.erase(it);
+    return old;
+}
+
+uint64_t KeyDirectory::outlierHolders(int key) const
+{
+    std::lock_guard<std::mutex> lock(outlier_mutex);
+    auto it = outliers.find(key);
+    return it == outliers.end() ? 0 : it->second;
+}
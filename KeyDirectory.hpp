@@ -0,0 +1,115 @@
+#ifndef KEY_DIRECTORY_HPP
+#define KEY_DIRECTORY_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+// Which replicas cache each key, as a bitmask of replica ids. Keys of
+// [0, dataset_size] have a word each; the rare keys outside that range live
+// in a hash table under a mutex. ReplicaManager sets a replica's bit before
+// putting a key into its cache and the cache's eviction callback clears it,
+// so a remote lookup is one load instead of a probe of every replica.
+// Words are updated atomically, so workers that only hold their own
+// replica's lock can share the directory.
+class KeyDirectory
+{
+public:
+    static constexpr int MAX_REPLICAS = 64;
+
+    explicit KeyDirectory(uint64_t dataset_size);
+
+    void insert(int key, int replica)
+    {
+        uint64_t bit = 1ull << replica;
+        uint64_t k = static_cast<uint32_t>(key);
+        uint64_t old = k < range ? masks[k].fetch_or(bit, std::memory_order_relaxed) : insertOutlier(key, bit);
+        if (counting && !(old & bit))
+        {
+            entries.fetch_add(1, std::memory_order_relaxed);
+            if (old == 0)
+                keys.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void erase(int key, int replica)
+    {
+        uint64_t bit = 1ull << replica;
+        uint64_t k = static_cast<uint32_t>(key);
+        uint64_t old = k < range ? masks[k].fetch_and(~bit, std::memory_order_relaxed) : eraseOutlier(key, bit);
+        if (counting && (old & bit))
+        {
+            entries.fetch_sub(1, std::memory_order_relaxed);
+            if (old == bit)
+                keys.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Keeps the totals below from now on; call before anything is cached
+    void countKeys() { counting = true; }
+    // Cached copies over all replicas, and distinct cached keys
+    uint64_t cachedEntries() const { return entries.load(std::memory_order_relaxed); }
+    uint64_t cachedKeys() const { return keys.load(std::memory_order_relaxed); }
+
+    uint64_t holders(int key) const
+    {
+        uint64_t k = static_cast<uint32_t>(key);
+        if (k < range)
+            return masks[k].load(std::memory_order_relaxed);
+        return outlierHolders(key);
+    }
+
+    // Pulls key's word into cache ahead of a holders() lookup on a miss
+    void prefetch(int key) const
+    {
+        uint64_t k = static_cast<uint32_t>(key);
+        if (k < range)
+            __builtin_prefetch(&masks[k]);
+    }
+
+    // Calls f(key, mask) for every key some replica caches
+    template <typename F>
+    void forEach(F &&f) const
+    {
+        forEachInRange(0, range, f);
+        forEachOutlier(f);
+    }
+
+    // The same for the cached keys of [begin, end), clamped to the dense range
+    template <typename F>
+    void forEachInRange(uint64_t begin, uint64_t end, F &&f) const
+    {
+        for (uint64_t k = begin; k < end && k < range; ++k)
+        {
+            if (uint64_t mask = masks[k].load(std::memory_order_relaxed))
+                f(static_cast<int>(k), mask);
+        }
+    }
+
+    // The same for the cached keys outside the dense range
+    template <typename F>
+    void forEachOutlier(F &&f) const
+    {
+        std::lock_guard<std::mutex> lock(outlier_mutex);
+        for (const auto &[key, mask] : outliers)
+            f(key, mask);
+    }
+
+private:
+    uint64_t range;
+    std::unique_ptr<std::atomic<uint64_t>[]> masks;
+    std::unordered_map<int, uint64_t> outliers;
+    mutable std::mutex outlier_mutex;
+    bool counting = false;
+    std::atomic<uint64_t> entries{0};
+    std::atomic<uint64_t> keys{0};
+
+    // Return the mask before the change
+    uint64_t insertOutlier(int key, uint64_t bit);
+    uint64_t eraseOutlier(int key, uint64_t bit);
+    uint64_t outlierHolders(int key) const;
+};
+
+#endif // KEY_DIRECTORY_HPP
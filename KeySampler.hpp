@@ -0,0 +1,62 @@
+#ifndef KEY_SAMPLER_HPP
+#define KEY_SAMPLER_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+// Spatial sampling as in SHARDS (Waldspurger et al.): a key is kept when a
+// hash of it falls in a range of [0, 2^24), so every request to a kept key is
+// kept and the sample behaves like the full trace over that share of the
+// keys. Kept keys are renumbered from 1 in order of first appearance, so
+// per-key structures sized by the scaled dataset stay dense.
+class KeySampler
+{
+public:
+    static constexpr uint32_t MODULUS = 1u << 24;
+    // Kept keys are split into this many groups by their new number; the
+    // spread of results across groups gives the sampling error
+    static constexpr int STRATA = 16;
+
+    // Keeps a rate share of the keys
+    explicit KeySampler(double rate)
+        : low(0), high(static_cast<uint32_t>(std::llround(rate * MODULUS)))
+    {
+    }
+
+    // Keeps shard of shards disjoint slices that together cover every key
+    KeySampler(uint32_t shard, uint32_t shards)
+        : low(static_cast<uint32_t>(uint64_t(MODULUS) * shard / shards)),
+          high(static_cast<uint32_t>(uint64_t(MODULUS) * (shard + 1) / shards))
+    {
+    }
+
+    // Share of the key space kept, after rounding to the hash resolution
+    double rate() const { return static_cast<double>(high - low) / MODULUS; }
+
+    // Whether requests to key are kept; if so, sampled_key is its new number
+    template <bool Concurrent>
+    bool sample(int key, int &sampled_key)
+    {
+        uint64_t h = static_cast<uint32_t>(key) * 0x9E3779B97F4A7C15ull;
+        h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ull;
+        h ^= h >> 31;
+        uint32_t slot = h & (MODULUS - 1);
+        if (slot < low || slot >= high)
+            return false;
+
+        std::unique_lock<std::mutex> lock(mutex, std::defer_lock);
+        if constexpr (Concurrent)
+            lock.lock();
+        sampled_key = ids.try_emplace(key, static_cast<int>(ids.size() + 1)).first->second;
+        return true;
+    }
+
+private:
+    uint32_t low, high;
+    std::unordered_map<int, int> ids;
+    std::mutex mutex;
+};
+
+#endif // KEY_SAMPLER_HPP
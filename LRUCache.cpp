@@ -4,7 +4,6 @@ LRUCache::LRUCache(size_t cap) : capacity(cap) {}
 
 int LRUCache::get(int key)
 {
-    std::lock_guard<std::mutex> lock(cache_mutex);
     auto it = cache.find(key);
     if (it == cache.end())
         return -1;
@@ -15,7 +14,6 @@ int LRUCache::get(int key)
 
 void LRUCache::put(int key, int value)
 {
-    std::lock_guard<std::mutex> lock(cache_mutex);
     auto it = cache.find(key);
     if (it != cache.end())
     {
@@ -29,6 +27,7 @@ void LRUCache::put(int key, int value)
         int lru = keys.back();
         keys.pop_back();
         cache.erase(lru);
+        evicted(lru);
     }
 
     keys.push_front(key);
@@ -37,29 +36,26 @@ void LRUCache::put(int key, int value)
 
 size_t LRUCache::size()
 {
-    std::lock_guard<std::mutex> lock(cache_mutex);
     return cache.size();
 }
 
 std::set<int> LRUCache::getKeys()
 {
-    std::lock_guard<std::mutex> lock(cache_mutex);
     return std::set<int>(keys.begin(), keys.end());
 }
 
 bool LRUCache::contains(int key)
 {
-    std::lock_guard<std::mutex> lock(cache_mutex);
     return cache.find(key) != cache.end();
 }
 
 void LRUCache::remove(int key)
 {
-    std::lock_guard<std::mutex> lock(cache_mutex);
     auto it = cache.find(key);
     if (it != cache.end())
     {
         keys.erase(it->second.second);
         cache.erase(it);
+        evicted(key);
     }
 }
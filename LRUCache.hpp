@@ -4,17 +4,15 @@
 #include "CacheBase.hpp"
 #include <unordered_map>
 #include <list>
-#include <mutex>
 #include <vector>
 #include <set>
 
-class LRUCache : public CacheBase
+class LRUCache final : public CacheBase
 {
 private:
     size_t capacity;
     std::list<int> keys;
     std::unordered_map<int, std::pair<int, std::list<int>::iterator>> cache;
-    mutable std::mutex cache_mutex;
 
 public:
     LRUCache(size_t cap);
@@ -24,6 +22,14 @@ public:
     std::set<int> getKeys() override;
     bool contains(int key) override;
     void remove(int key) override;
+    // Loads the key's bucket and prefetches the first node chained to it
+    void prefetch(int key) const override
+    {
+        size_t bucket = cache.bucket(key);
+        auto node = cache.cbegin(bucket);
+        if (node != cache.cend(bucket))
+            __builtin_prefetch(&*node);
+    }
 };
 
 #endif // LRU_CACHE_HPP
@@ -0,0 +1,81 @@
+#include "LatencyHistogram.hpp"
+#include <algorithm>
+#include <cmath>
+
+LatencyHistogram::LatencyHistogram()
+    : counts(bucketOf((1ull << MAX_BITS) - 1) + 1, 0), sums(counts.size(), 0)
+{
+}
+
+void LatencyHistogram::merge(const LatencyHistogram &other)
+{
+    for (size_t i = 0; i < counts.size(); ++i)
+    {
+        counts[i] += other.counts[i];
+        sums[i] += other.sums[i];
+    }
+}
+
+uint64_t LatencyHistogram::count() const
+{
+    uint64_t total = 0;
+    for (uint64_t c : counts)
+        total += c;
+    return total;
+}
+
+double LatencyHistogram::percentile(double p) const
+{
+    uint64_t total = count();
+    if (total == 0)
+        return 0;
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(p * total)));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts.size(); ++i)
+    {
+        seen += counts[i];
+        if (seen >= rank)
+            return static_cast<double>(sums[i]) / counts[i] / 1000;
+    }
+    return 0;
+}
+
+uint64_t LatencyHistogram::bucketLow(size_t bucket)
+{
+    if (bucket < (1ull << SUB_BITS))
+        return bucket;
+    size_t half = size_t(1) << (SUB_BITS - 1);
+    size_t shift = bucket / half - 1;
+    return static_cast<uint64_t>(bucket - shift * half) << shift;
+}
+
+LatencyModel::LatencyModel(const std::string &model, int latency_local, int latency_rdma, int latency_disk, double sigma,
+                           uint64_t seed)
+    : lognormal(model == "lognormal"), sigma(sigma), seed(seed)
+{
+    int means_us[LATENCY_OUTCOMES] = {latency_local, latency_rdma, latency_disk};
+    for (int i = 0; i < LATENCY_OUTCOMES; ++i)
+    {
+        means_ns[i] = static_cast<uint64_t>(means_us[i]) * 1000;
+        // The mean of a lognormal is exp(mu + sigma^2 / 2)
+        mu[i] = std::log(std::max<double>(means_ns[i], 1)) - sigma * sigma / 2;
+    }
+}
+
+static uint64_t mix(uint64_t x)
+{
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+uint64_t LatencyModel::sampleLognormal(LatencyOutcome outcome, uint64_t request, int key) const
+{
+    int i = static_cast<int>(outcome);
+    uint64_t h = mix(seed + mix(request * 0x9E3779B97F4A7C15ull + static_cast<uint32_t>(key)) + i);
+    // Box-Muller on the two halves of the hash, each in (0, 1]
+    double u1 = (static_cast<double>(h >> 32) + 1) / 4294967296.0;
+    double u2 = (static_cast<double>(h & 0xFFFFFFFFu) + 1) / 4294967296.0;
+    double z = std::sqrt(-2 * std::log(u1)) * std::cos(2 * M_PI * u2);
+    return std::llround(std::exp(mu[i] + sigma * z));
+}
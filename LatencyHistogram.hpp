@@ -0,0 +1,96 @@
+#ifndef LATENCY_HISTOGRAM_HPP
+#define LATENCY_HISTOGRAM_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Where a request was served from
+enum class LatencyOutcome
+{
+    LocalHit,
+    RemoteHit,
+    DiskMiss,
+};
+constexpr int LATENCY_OUTCOMES = 3;
+
+// Log-bucketed histogram of latencies in nanoseconds, in the style of
+// HdrHistogram: values below 2^SUB_BITS have a bucket each, and every
+// power-of-two range above that is split into 2^(SUB_BITS - 1) buckets, so a
+// bucket is never wider than 1/128 of its values. Each bucket also sums its
+// values, and percentiles report the mean of their bucket, which is exact
+// for constant latencies. Histograms of the same layout merge by adding.
+class LatencyHistogram
+{
+public:
+    static constexpr int SUB_BITS = 8;
+    // Values at or above 2^MAX_BITS ns (about 18 minutes) share the last bucket
+    static constexpr int MAX_BITS = 40;
+
+    LatencyHistogram();
+
+    void record(uint64_t value)
+    {
+        size_t bucket = bucketOf(value);
+        counts[bucket]++;
+        sums[bucket] += value;
+    }
+
+    void merge(const LatencyHistogram &other);
+    uint64_t count() const;
+    // Latency in microseconds at or below which a share p of the values lie;
+    // 0 when empty
+    double percentile(double p) const;
+
+    size_t buckets() const { return counts.size(); }
+    uint64_t bucketCount(size_t bucket) const { return counts[bucket]; }
+    // Smallest value of a bucket, in nanoseconds
+    static uint64_t bucketLow(size_t bucket);
+
+private:
+    std::vector<uint64_t> counts;
+    std::vector<uint64_t> sums;
+
+    static size_t bucketOf(uint64_t value)
+    {
+        if (value < (1ull << SUB_BITS))
+            return value;
+        int exponent = 63 - __builtin_clzll(value);
+        if (exponent >= MAX_BITS)
+            return bucketOf((1ull << MAX_BITS) - 1);
+        int shift = exponent - SUB_BITS + 1;
+        return (static_cast<size_t>(shift) << (SUB_BITS - 1)) + (value >> shift);
+    }
+};
+
+// Latency of each outcome: the configured constants, or with lognormal a
+// sample of a lognormal distribution with that mean and a shape of sigma.
+// Samples are a hash of the request's position and key instead of a
+// generator's next draw, so every way of replaying a trace in order draws the
+// same latency for the same request.
+class LatencyModel
+{
+public:
+    LatencyModel(const std::string &model, int latency_local, int latency_rdma, int latency_disk, double sigma,
+                 uint64_t seed);
+
+    // In nanoseconds
+    uint64_t sample(LatencyOutcome outcome, uint64_t request, int key) const
+    {
+        if (!lognormal)
+            return means_ns[static_cast<int>(outcome)];
+        return sampleLognormal(outcome, request, key);
+    }
+
+private:
+    bool lognormal;
+    uint64_t means_ns[LATENCY_OUTCOMES];
+    double mu[LATENCY_OUTCOMES];
+    double sigma;
+    uint64_t seed;
+
+    uint64_t sampleLognormal(LatencyOutcome outcome, uint64_t request, int key) const;
+};
+
+#endif // LATENCY_HISTOGRAM_HPP
@@ -2,55 +2,122 @@
 #include <cmath>
 #include <algorithm>
 #include <iostream>
+#include <mutex>
+#include <unordered_map>
 
-Metrics::Metrics(const std::vector<std::set<int>> &key_sets, float cache_pct, int num_keys_seen,
+// Number of keys in exactly d of key_sets at index d. Each word position
+// adds the sets' words into bit-sliced counters, one word per counter bit, so
+// 64 keys are counted at once; word ranges are counted in parallel.
+static std::vector<uint64_t> degreeHistogram(const std::vector<KeyBitmap> &key_sets)
+{
+    size_t nsets = key_sets.size();
+    size_t num_words = 0;
+    for (const auto &s : key_sets)
+        num_words = std::max(num_words, s.bits().size());
+    int levels = 1;
+    while ((size_t(1) << levels) <= nsets)
+        levels++;
+
+    std::vector<uint64_t> histogram(nsets + 1, 0);
+    std::mutex histogram_mutex;
+    forEachWordRange(num_words, [&](size_t begin, size_t end)
+                     {
+        std::vector<uint64_t> local(nsets + 1, 0);
+        std::vector<uint64_t> counter(levels);
+        for (size_t w = begin; w < end; ++w)
+        {
+            std::fill(counter.begin(), counter.end(), 0);
+            for (const auto &s : key_sets)
+            {
+                uint64_t carry = w < s.bits().size() ? s.bits()[w] : 0;
+                for (int b = 0; carry && b < levels; ++b)
+                {
+                    uint64_t next = counter[b] & carry;
+                    counter[b] ^= carry;
+                    carry = next;
+                }
+            }
+            for (size_t d = 1; d <= nsets; ++d)
+            {
+                uint64_t match = ~0ull;
+                for (int b = 0; b < levels; ++b)
+                    match &= ((d >> b) & 1) ? counter[b] : ~counter[b];
+                local[d] += __builtin_popcountll(match);
+            }
+        }
+        std::lock_guard<std::mutex> lock(histogram_mutex);
+        for (size_t d = 1; d <= nsets; ++d)
+            histogram[d] += local[d]; });
+
+    // Keys outside the dense range, counted once per set that holds them
+    std::unordered_map<int, std::pair<size_t, size_t>> outliers; // key -> (last set + 1, sets)
+    for (size_t i = 0; i < nsets; ++i)
+    {
+        for (int key : key_sets[i].outlierKeys())
+        {
+            auto &[last, sets] = outliers[key];
+            if (last != i + 1)
+            {
+                last = i + 1;
+                sets++;
+            }
+        }
+    }
+    for (const auto &entry : outliers)
+        histogram[entry.second.second]++;
+    return histogram;
+}
+
+Metrics::Metrics(const std::vector<KeyBitmap> &key_sets, float cache_pct, int num_keys_seen,
                  float overall_miss_ratio, float remote_miss_ratio, float local_miss_ratio,
                  const std::vector<float> &replica_miss_ratios, int total_keys_admitted, float avg_latency)
     : overall_miss_ratio(overall_miss_ratio), remote_miss_ratio(remote_miss_ratio),
       local_dup_miss_ratio(local_miss_ratio), replica_miss_ratios(replica_miss_ratios),
       total_keys_admitted(total_keys_admitted), avg_latency(avg_latency)
 {
-
     int nsets = key_sets.size();
-    std::set<int> keys_union, keys_intersect;
-    for (const auto &s : key_sets)
+    replication_degrees = degreeHistogram(key_sets);
+
+    // Every key held anywhere is in the union, once per replica in the total
+    // and in the intersection only when all replicas hold it
+    uint64_t nunique = 0, total_size = 0;
+    for (int d = 1; d <= nsets; ++d)
     {
-        keys_union.insert(s.begin(), s.end());
-        if (keys_intersect.empty())
-        {
-            keys_intersect = s;
-        }
-        else
-        {
-            std::set<int> temp;
-            std::set_intersection(keys_intersect.begin(), keys_intersect.end(),
-                                  s.begin(), s.end(),
-                                  std::inserter(temp, temp.begin()));
-            keys_intersect = std::move(temp);
-        }
+        nunique += replication_degrees[d];
+        total_size += d * replication_degrees[d];
     }
+    uint64_t nintersect = nsets > 0 ? replication_degrees[nsets] : 0;
 
-    int total_size = std::accumulate(key_sets.begin(), key_sets.end(), 0,
-                                     [](int sum, const std::set<int> &s)
-                                     { return sum + s.size(); });
-
-    dataset_coverage = static_cast<float>(keys_union.size()) / num_keys_seen;
+    dataset_coverage = static_cast<float>(nunique) / num_keys_seen;
     replica_utilization = dataset_coverage / std::min(1.0f, nsets * cache_pct);
 
-    int nunique = keys_union.size();
     sorensen_similarity = (nsets / static_cast<float>(nsets - 1)) * (1.0f - (static_cast<float>(nunique) / total_size));
 
     float avg_cache_size = static_cast<float>(total_size) / nsets;
-    overlap_pct = avg_cache_size > 0 ? static_cast<float>(keys_intersect.size()) / avg_cache_size : 0;
+    overlap_pct = avg_cache_size > 0 ? static_cast<float>(nintersect) / avg_cache_size : 0;
+}
 
-    std::unordered_map<int, int> key_counts;
-    for (const auto &s : key_sets)
-    {
-        for (int k : s)
-        {
-            key_counts[k]++;
-        }
-    }
+void Metrics::setSampleBounds(float rate, float overall_miss_ratio_bound, float local_miss_ratio_bound, float avg_latency_bound)
+{
+    sample_rate = rate;
+    this->overall_miss_ratio_bound = overall_miss_ratio_bound;
+    this->local_miss_ratio_bound = local_miss_ratio_bound;
+    this->avg_latency_bound = avg_latency_bound;
+}
+
+void Metrics::setLatencyHistograms(std::vector<LatencyHistogram> outcomes, std::vector<LatencyHistogram> replicas)
+{
+    outcome_latency = std::move(outcomes);
+    replica_latency = std::move(replicas);
+    latency = LatencyHistogram();
+    for (const auto &histogram : outcome_latency)
+        latency.merge(histogram);
+}
+
+static void writePercentiles(std::ofstream &file, const std::string &label, const LatencyHistogram &histogram)
+{
+    file << label << " Latency Percentiles (p50 p90 p99 p999): " << histogram.percentile(0.5) << " "
+         << histogram.percentile(0.9) << " " << histogram.percentile(0.99) << " " << histogram.percentile(0.999) << "\n";
 }
 
 void Metrics::writeToFile(const std::string &filename) const
@@ -76,5 +143,60 @@ void Metrics::writeToFile(const std::string &filename) const
     }
     file << "\n";
     file << "Total Keys Admitted: " << total_keys_admitted << "\n";
+    // Sampled runs scale key counts to the full key space
+    file << "Replication Degree Histogram: ";
+    for (size_t d = 1; d < replication_degrees.size(); ++d)
+    {
+        file << std::llround(replication_degrees[d] / sample_rate) << " ";
+    }
+    file << "\n";
+    if (!outcome_latency.empty())
+    {
+        static const char *OUTCOME_NAMES[LATENCY_OUTCOMES] = {"Local Hit", "Remote Hit", "Disk Miss"};
+        writePercentiles(file, "Overall", latency);
+        for (int o = 0; o < LATENCY_OUTCOMES; ++o)
+            writePercentiles(file, OUTCOME_NAMES[o], outcome_latency[o]);
+        for (size_t i = 0; i < replica_latency.size(); ++i)
+            writePercentiles(file, "Replica " + std::to_string(i), replica_latency[i]);
+    }
+    if (sample_rate < 1)
+    {
+        file << "Sample Rate: " << sample_rate << "\n"
+             << "Average Latency 95% CI: +/- " << avg_latency_bound << "\n"
+             << "Overall Miss Ratio 95% CI: +/- " << overall_miss_ratio_bound << "\n"
+             << "Local Miss Ratio 95% CI: +/- " << local_miss_ratio_bound << "\n";
+    }
     file.close();
 }
+
+bool Metrics::writeLatencyHistogramToFile(const std::string &filename) const
+{
+    std::ofstream file(filename);
+    if (!file)
+    {
+        std::cerr << "Error: Unable to open file " << filename << std::endl;
+        return false;
+    }
+
+    file << "low_us,high_us,all,local_hit,remote_hit,disk_miss";
+    for (size_t i = 0; i < replica_latency.size(); ++i)
+        file << ",replica_" << i;
+    file << "\n";
+
+    // Sampled runs scale request counts to the full trace
+    auto scaled = [&](uint64_t count)
+    { return std::llround(count / sample_rate); };
+    for (size_t b = 0; b < latency.buckets(); ++b)
+    {
+        if (latency.bucketCount(b) == 0)
+            continue;
+        file << LatencyHistogram::bucketLow(b) / 1000.0 << "," << LatencyHistogram::bucketLow(b + 1) / 1000.0 << ","
+             << scaled(latency.bucketCount(b));
+        for (const auto &histogram : outcome_latency)
+            file << "," << scaled(histogram.bucketCount(b));
+        for (const auto &histogram : replica_latency)
+            file << "," << scaled(histogram.bucketCount(b));
+        file << "\n";
+    }
+    return true;
+}
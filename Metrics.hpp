@@ -1,11 +1,11 @@
 #ifndef METRICS_HPP
 #define METRICS_HPP
 
+#include "KeyBitmap.hpp"
+#include "LatencyHistogram.hpp"
 #include <vector>
-#include <set>
-#include <unordered_map>
-#include <numeric>
 #include <fstream>
+#include <string>
 
 class Metrics
 {
@@ -20,13 +20,30 @@ private:
     float avg_latency;
     int total_keys_admitted;
     std::vector<float> replica_miss_ratios;
+    // Keys cached by exactly d replicas at index d, from 1
+    std::vector<uint64_t> replication_degrees;
+    float sample_rate = 1;
+    float overall_miss_ratio_bound = 0;
+    float local_miss_ratio_bound = 0;
+    float avg_latency_bound = 0;
+    std::vector<LatencyHistogram> outcome_latency;
+    std::vector<LatencyHistogram> replica_latency;
+    LatencyHistogram latency;
 
 public:
-    Metrics(const std::vector<std::set<int>> &key_sets, float cache_pct, int num_keys_seen,
+    // key_sets holds each replica's keys, all over the same key range
+    Metrics(const std::vector<KeyBitmap> &key_sets, float cache_pct, int num_keys_seen,
             float overall_miss_ratio, float remote_miss_ratio, float local_miss_ratio,
             const std::vector<float> &replica_miss_ratios, int total_keys_admitted, float avg_latency);
 
+    // Sampled runs also report the rate and 95% confidence half-widths
+    void setSampleBounds(float rate, float overall_miss_ratio_bound, float local_miss_ratio_bound, float avg_latency_bound);
+    // Per outcome, indexed by LatencyOutcome, and per primary replica
+    void setLatencyHistograms(std::vector<LatencyHistogram> outcomes, std::vector<LatencyHistogram> replicas);
     void writeToFile(const std::string &filename) const;
+    // One CSV row per non-empty latency bucket with its request count overall,
+    // per outcome and per replica
+    bool writeLatencyHistogramToFile(const std::string &filename) const;
 };
 
 #endif // METRICS_HPP
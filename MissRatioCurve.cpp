@@ -0,0 +1,224 @@
+#include "MissRatioCurve.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+StackDistance::StackDistance(uint64_t dataset_size)
+    : last_access(dataset_size + 1, NONE), range(dataset_size + 1)
+{
+    size_t times = std::max<uint64_t>(1 << 16, 2 * range);
+    tree.assign(times + 1, 0);
+    time_slot.assign(times, NONE);
+}
+
+uint32_t StackDistance::slotOf(int key)
+{
+    uint64_t k = static_cast<uint32_t>(key);
+    if (k < range)
+        return static_cast<uint32_t>(k);
+    auto [it, inserted] = outlier_slots.try_emplace(key, static_cast<uint32_t>(last_access.size()));
+    if (inserted)
+        last_access.push_back(NONE);
+    return it->second;
+}
+
+uint32_t StackDistance::marksAfter(uint32_t time) const
+{
+    uint32_t up_to = 0;
+    for (size_t i = time + 1; i > 0; i -= i & (~i + 1))
+        up_to += tree[i];
+    return marked - up_to;
+}
+
+void StackDistance::add(uint32_t time, int delta)
+{
+    for (size_t i = time + 1; i < tree.size(); i += i & (~i + 1))
+        tree[i] += delta;
+}
+
+uint64_t StackDistance::access(int key)
+{
+    uint32_t slot = slotOf(key);
+    uint32_t last = last_access[slot];
+    uint64_t distance = COLD;
+    if (last != NONE)
+    {
+        distance = marksAfter(last);
+        add(last, -1);
+        time_slot[last] = NONE;
+        marked--;
+    }
+    if (now == time_slot.size())
+        compact();
+    add(now, 1);
+    time_slot[now] = slot;
+    last_access[slot] = now++;
+    marked++;
+    return distance;
+}
+
+uint64_t StackDistance::distance(int key) const
+{
+    uint64_t k = static_cast<uint32_t>(key);
+    uint32_t last = NONE;
+    if (k < range)
+    {
+        last = last_access[k];
+    }
+    else
+    {
+        auto it = outlier_slots.find(key);
+        if (it != outlier_slots.end())
+            last = last_access[it->second];
+    }
+    return last == NONE ? COLD : marksAfter(last);
+}
+
+// Renumbers the marked times 0..marked-1 in order, doubling the time range
+// while it is less than twice the number of marks
+void StackDistance::compact()
+{
+    size_t times = time_slot.size();
+    while (times < 2 * static_cast<size_t>(marked))
+        times *= 2;
+
+    std::vector<uint32_t> compacted(times, NONE);
+    uint32_t next = 0;
+    for (uint32_t t = 0; t < now; ++t)
+    {
+        if (time_slot[t] == NONE)
+            continue;
+        compacted[next] = time_slot[t];
+        last_access[time_slot[t]] = next++;
+    }
+    time_slot.swap(compacted);
+    now = next;
+
+    // Linear-time Fenwick build over the marks at 0..now-1
+    tree.assign(times + 1, 0);
+    for (size_t i = 1; i < tree.size(); ++i)
+    {
+        if (i <= now)
+            tree[i]++;
+        size_t parent = i + (i & (~i + 1));
+        if (parent < tree.size())
+            tree[parent] += tree[i];
+    }
+}
+
+MissRatioCurve::MissRatioCurve(int num_replicas, uint64_t dataset_size, int points, bool rdma_enabled, const Router &router)
+    : dataset_size(dataset_size), rdma_enabled(rdma_enabled), single(dataset_size), router(router), replica_requests(num_replicas, 0),
+      single_hits(points + 1, 0), local_hits(num_replicas, std::vector<uint64_t>(points + 1, 0)),
+      remote_hits(num_replicas, std::vector<uint64_t>(points + 1, 0))
+{
+    for (int p = 1; p <= points; ++p)
+        capacities.push_back(std::max<uint64_t>(1, dataset_size * p / points));
+    if (rdma_enabled)
+    {
+        shared = std::make_unique<StackDistance>(dataset_size);
+        holders.assign(dataset_size + 1, -1);
+    }
+    else
+    {
+        for (int i = 0; i < num_replicas; ++i)
+            replicas.emplace_back(std::make_unique<StackDistance>(dataset_size));
+    }
+}
+
+// Index of the smallest capacity above distance, or the number of
+// capacities if none is
+size_t MissRatioCurve::firstHit(uint64_t distance) const
+{
+    return std::upper_bound(capacities.begin(), capacities.end(), distance) - capacities.begin();
+}
+
+int &MissRatioCurve::holderOf(int key)
+{
+    uint64_t k = static_cast<uint32_t>(key);
+    if (k < holders.size())
+        return holders[k];
+    return outlier_holders.try_emplace(key, -1).first->second;
+}
+
+void MissRatioCurve::record(const int *keys, size_t count)
+{
+    int num_replicas = static_cast<int>(replica_requests.size());
+    for (size_t i = 0; i < count; ++i)
+    {
+        int key = keys[i];
+        int primary = router.route(key, -1);
+
+        requests++;
+        replica_requests[primary]++;
+        single_hits[firstHit(single.access(key))]++;
+
+        if (!rdma_enabled)
+        {
+            local_hits[primary][firstHit(replicas[primary]->access(key))]++;
+            continue;
+        }
+
+        // The key is cached at num_replicas * capacity > distance
+        int &holder = holderOf(key);
+        uint64_t distance = shared->distance(key);
+        if (distance == StackDistance::COLD)
+        {
+            holder = primary;
+            shared->access(key);
+        }
+        else if (holder == primary)
+        {
+            local_hits[primary][firstHit(distance / num_replicas)]++;
+            shared->access(key);
+        }
+        else
+        {
+            remote_hits[primary][firstHit(distance / num_replicas)]++;
+        }
+    }
+}
+
+bool MissRatioCurve::writeToFile(const std::string &filename, int latency_local, int latency_rdma, int latency_disk) const
+{
+    std::ofstream file(filename);
+    if (!file)
+    {
+        std::cerr << "Error: Unable to open file " << filename << std::endl;
+        return false;
+    }
+
+    size_t num_replicas = replica_requests.size();
+    file << "capacity,cache_percentage,lru_miss_ratio,local_hit_ratio,remote_hit_ratio,miss_ratio,avg_latency";
+    for (size_t r = 0; r < num_replicas; ++r)
+        file << ",replica_" << r << "_miss_ratio";
+    file << "\n";
+
+    double total = std::max<uint64_t>(requests, 1);
+    uint64_t single_hit = 0;
+    std::vector<uint64_t> local_hit(num_replicas, 0);
+    std::vector<uint64_t> remote_hit(num_replicas, 0);
+    for (size_t p = 0; p < capacities.size(); ++p)
+    {
+        single_hit += single_hits[p];
+        uint64_t local = 0, remote = 0;
+        for (size_t r = 0; r < num_replicas; ++r)
+        {
+            local_hit[r] += local_hits[r][p];
+            remote_hit[r] += remote_hits[r][p];
+            local += local_hit[r];
+            remote += remote_hit[r];
+        }
+        uint64_t misses = requests - local - remote;
+        double latency = (static_cast<double>(local) * latency_local + static_cast<double>(remote) * latency_rdma +
+                          static_cast<double>(misses) * latency_disk) /
+                         total;
+
+        file << capacities[p] << "," << static_cast<double>(capacities[p]) / dataset_size << ","
+             << (requests - single_hit) / total << "," << local / total << "," << remote / total << ","
+             << misses / total << "," << latency;
+        for (size_t r = 0; r < num_replicas; ++r)
+            file << "," << (replica_requests[r] - local_hit[r] - remote_hit[r]) / total;
+        file << "\n";
+    }
+    return true;
+}
@@ -0,0 +1,97 @@
+#ifndef MISS_RATIO_CURVE_HPP
+#define MISS_RATIO_CURVE_HPP
+
+#include "Router.hpp"
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// LRU stack distances (Mattson et al.): the number of distinct keys accessed
+// since the previous access to a key, so an LRU cache of capacity C hits
+// exactly the accesses at distance < C. Each key marks the time of its last
+// access in a Fenwick tree and its distance is the number of marks after it.
+// When the times run out the marks are renumbered in order, so the tree stays
+// within twice the number of distinct keys instead of the trace length.
+class StackDistance
+{
+public:
+    static constexpr uint64_t COLD = UINT64_MAX;
+
+    explicit StackDistance(uint64_t dataset_size);
+
+    // Records an access and returns its distance, COLD for a first access
+    uint64_t access(int key);
+    // Distance an access to key would have now, without recording it
+    uint64_t distance(int key) const;
+
+private:
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    std::vector<uint32_t> tree;        // Fenwick tree over times, 1-based
+    std::vector<uint32_t> time_slot;   // key slot last accessed at each time
+    std::vector<uint32_t> last_access; // per key slot, NONE until accessed
+    // Keys of [0, dataset_size] use the key as slot, others get a slot past
+    // range on first access
+    std::unordered_map<int, uint32_t> outlier_slots;
+    uint64_t range;
+    uint32_t now = 0;
+    uint32_t marked = 0;
+
+    uint32_t slotOf(int key);
+    uint32_t marksAfter(uint32_t time) const;
+    void add(uint32_t time, int delta);
+    void compact();
+};
+
+// LRU miss-ratio curves for points evenly spaced per-replica capacities up
+// to the dataset size, from one pass over a trace. Requests are routed to a
+// primary replica by the router a single-threaded ReplicaManager would use.
+//
+// Without RDMA each replica is an LRU cache over the requests routed to it,
+// so one stack per replica gives its curve exactly. With RDMA a remote hit is
+// not cached at the primary, so a key is held by at most one replica: the one
+// whose miss brought it in. That is modelled as one stack of num_replicas
+// times the capacity in which only requests routed to a key's holder refresh
+// it. A key keeps the holder of its first request, where the simulator moves
+// it to whichever replica misses on it after an eviction, so the curve is an
+// approximation that slightly overstates misses.
+class MissRatioCurve
+{
+public:
+    MissRatioCurve(int num_replicas, uint64_t dataset_size, int points, bool rdma_enabled, const Router &router);
+
+    void record(const int *keys, size_t count);
+    // One CSV row per capacity with the miss ratio of a single LRU cache of
+    // that size, the replicated hit/miss split and average latency, and each
+    // replica's misses as a share of all requests
+    bool writeToFile(const std::string &filename, int latency_local, int latency_rdma, int latency_disk) const;
+
+private:
+    uint64_t dataset_size;
+    std::vector<uint64_t> capacities; // ascending
+    bool rdma_enabled;
+    StackDistance single;
+    // One stack per replica without RDMA, a shared one and each key's holder
+    // with it
+    std::vector<std::unique_ptr<StackDistance>> replicas;
+    std::unique_ptr<StackDistance> shared;
+    std::vector<int> holders;
+    std::unordered_map<int, int> outlier_holders;
+    // Routes as ReplicaManager's worker 0
+    Router router;
+    uint64_t requests = 0;
+    std::vector<uint64_t> replica_requests;
+    // Requests by the index of the first capacity they hit at, per primary
+    // replica for the replicated curve
+    std::vector<uint64_t> single_hits;
+    std::vector<std::vector<uint64_t>> local_hits;
+    std::vector<std::vector<uint64_t>> remote_hits;
+
+    size_t firstHit(uint64_t distance) const;
+    int &holderOf(int key);
+};
+
+#endif // MISS_RATIO_CURVE_HPP
@@ -1,30 +1,26 @@
 #include "Replica.hpp"
+#include <stdexcept>
 
-Replica::Replica(int replica_id, size_t cache_size, const std::string &cache_type)
-    : id(replica_id)
+std::unique_ptr<CacheBase> makeCache(const std::string &cache_type, size_t cache_size)
 {
     if (cache_type == "S3FIFO")
     {
-        cache = std::make_unique<S3FIFOCache>(cache_size);
-        std::cout << "Replica " << id << "created with S3FIFO cache\n";
+        return std::make_unique<S3FIFOCache>(cache_size);
     }
     else if (cache_type == "LRU")
     {
-        cache = std::make_unique<LRUCache>(cache_size);
-        std::cout << "Replica " << id << "created with LRU cache\n";
+        return std::make_unique<LRUCache>(cache_size);
+    }
+    else if (cache_type == "FlatLRU")
+    {
+        return std::make_unique<FlatLRUCache>(cache_size);
+    }
+    else if (cache_type == "RingS3FIFO")
+    {
+        return std::make_unique<RingS3FIFOCache>(cache_size);
     }
     else
     {
         throw std::invalid_argument("Unsupported cache type: " + cache_type);
     }
 }
-
-int Replica::processRequest(int key)
-{
-    return cache->get(key);
-}
-
-bool Replica::hasKey(int key)
-{
-    return cache->contains(key);
-}
@@ -1,25 +1,40 @@
 #ifndef REPLICA_HPP
 #define REPLICA_HPP
 
-#include "CacheBase.hpp"
-#include "LRUCache.hpp"
-#include "S3FIFOCache.hpp"
+#include "CachePolicies.hpp"
 #include <memory>
+#include <mutex>
 #include <iostream>
 
+template <typename Policy>
 class Replica
 {
 public:
+    using Cache = typename Policy::Cache;
+
     int id;
-    std::unique_ptr<CacheBase> cache;
+    std::unique_ptr<Cache> cache;
+    // Held by ReplicaManager around cache calls when requests run concurrently
+    std::mutex mutex;
 
-    Replica(int replica_id, size_t cache_size, const std::string &cache_type);
+    Replica(int replica_id, size_t cache_size, const std::string &cache_type)
+        : id(replica_id), cache(Policy::create(cache_size, cache_type))
+    {
+        std::cout << "Replica " << id << "created with " << cache_type << " cache\n";
+    }
 
     Replica(const Replica &) = delete;
     Replica &operator=(const Replica &) = delete;
 
-    int processRequest(int key);
-    bool hasKey(int key);
+    int processRequest(int key)
+    {
+        return cache->get(key);
+    }
+
+    bool hasKey(int key)
+    {
+        return cache->contains(key);
+    }
 };
 
 #endif // REPLICA_HPP
@@ -1,34 +1,132 @@
 #include "ReplicaManager.hpp"
 #include <chrono>
 #include <algorithm>
+#include <cmath>
 
-ReplicaManager::ReplicaManager(ConfigManager &config)
-    : replica_misses(config.num_replicas, 0), remote_fetches(config.num_replicas, 0), cache_contents(config.num_replicas),
-      rdma_enabled(config.rdma_enabled), enable_cba(config.enable_cba), stop_cba_thread(false), update_interval(config.update_interval),
-      dataset_size(config.total_dataset_size), latency_local(config.latency_local), latency_rdma(config.latency_rdma), latency_disk(config.latency_disk),
-      enable_de_duplication(enable_de_duplication), is_access_rate_fixed(config.is_access_rate_fixed)
+template <typename Policy>
+ReplicaManager<Policy>::ReplicaManager(ConfigManager &config)
+    : dataset_size(config.total_dataset_size), rdma_enabled(config.rdma_enabled), enable_cba(config.enable_cba),
+      enable_de_duplication(config.enable_de_duplication), is_access_rate_fixed(config.is_access_rate_fixed),
+      stop_cba_thread(false), update_interval(config.update_interval),
+      latency_local(config.latency_local), latency_rdma(config.latency_rdma), latency_disk(config.latency_disk),
+      latency_model(config.latency_model, config.latency_local, config.latency_rdma, config.latency_disk, config.latency_sigma, config.latency_seed)
 {
     workload_folder = config.workload_folder;
     cache_type = config.cache_type;
     for (int i = 0; i < config.num_replicas; ++i)
     {
-        replicas.emplace_back(std::make_unique<Replica>(i, config.cache_size, cache_type));
+        replicas.emplace_back(std::make_unique<Replica<Policy>>(i, config.cache_size, cache_type));
+    }
+    if (config.num_replicas <= KeyDirectory::MAX_REPLICAS)
+    {
+        directory = std::make_unique<KeyDirectory>(config.total_dataset_size);
+        for (int i = 0; i < config.num_replicas; ++i)
+            replicas[i]->cache->setEvictionCallback([this, i](int key)
+                                                    { directory->erase(key, i); });
+    }
+    if (config.key_shards > 1)
+    {
+        key_shards = config.key_shards;
+        key_shard = config.key_shard;
+        sampler = std::make_unique<KeySampler>(key_shard, key_shards);
+        shard_contents.assign(config.num_replicas, KeyBitmap((config.total_dataset_size + 1) * key_shards));
+    }
+    else if (config.sample_rate < 1)
+    {
+        sampler = std::make_unique<KeySampler>(config.sample_rate);
+        sampled_run = true;
+        std::cout << "Simulating a " << sampler->rate() << " sample of the keys\n";
+    }
+    admission_kind = config.admission_filter == "bloom" ? AdmissionFilter::Kind::Bloom : AdmissionFilter::Kind::Bitset;
+    admission_bloom_bits_per_key = config.admission_bloom_bits_per_key;
+    admitted_keys = std::make_shared<const AdmissionSet>();
+    pipelined = config.replica_pipeline;
+    metrics_window = config.metrics_window;
+    Router::Kind routing = Router::parseKind(config.routing);
+    int num_workers = std::max(config.num_threads, 1) + (pipelined ? config.num_replicas : 0);
+    for (int i = 0; i < num_workers; ++i)
+    {
+        auto state = std::make_unique<WorkerState>();
+        state->replica_misses.assign(config.num_replicas, 0);
+        state->replica_remote_fetches.assign(config.num_replicas, 0);
+        state->replica_latency.resize(config.num_replicas);
+        state->admitted_keys = admitted_keys;
+        state->router = Router(routing, config.num_replicas, config.routing_seed, i);
+        if (sampled_run)
+        {
+            state->stratum_requests.assign(KeySampler::STRATA, 0);
+            state->stratum_remote_fetches.assign(KeySampler::STRATA, 0);
+            state->stratum_misses.assign(KeySampler::STRATA, 0);
+        }
+        workers.push_back(std::move(state));
     }
     if (is_access_rate_fixed)
     {
         R_opt = config.fixed_access_rate;
     }
+    // A fixed access rate never analyzes frequencies, so it has nothing to
+    // measure drift against
+    if (config.cba_trigger == "drift" && !is_access_rate_fixed)
+    {
+        cba_trigger = CBATrigger::Drift;
+        cba_min_interval = config.cba_min_interval;
+        cba_max_interval = std::max(config.cba_max_interval, cba_min_interval);
+        cba_drift_threshold = config.cba_drift_threshold;
+        cba_drift_top_k = config.cba_drift_top_k;
+    }
     if (enable_cba)
     {
-        cba = std::make_unique<CostBenefitAnalyzer>(config.num_replicas, dataset_size, config.cache_size, latency_local, latency_rdma, latency_disk);
+        RedundancyOptimizer optimizer = config.cba_optimizer == "search" ? RedundancyOptimizer::Search : RedundancyOptimizer::Scan;
+        cba = std::make_unique<CostBenefitAnalyzer>(config.num_replicas, dataset_size, config.cache_size, latency_local, latency_rdma, latency_disk, optimizer);
+        auto makeFrequencyTable = [&]()
+        {
+            if (config.frequency_tracking == "sketch")
+                return std::make_unique<FrequencyTable>(dataset_size, config.sketch_memory_mb << 20, config.sketch_top_k);
+            if (config.frequency_tracking == "decayed")
+                return std::make_unique<FrequencyTable>(dataset_size, config.frequency_half_life);
+            return std::make_unique<FrequencyTable>(dataset_size);
+        };
+        frequency_buffers[0] = makeFrequencyTable();
+        active_frequencies = frequency_buffers[0].get();
+
+        if (config.cba_mode != "inline" && !is_access_rate_fixed)
+        {
+            cba_mode = config.cba_mode == "async" ? CBAMode::Async : CBAMode::Deterministic;
+            // A result must be applied before the next interval seals
+            cba_apply_offset = std::min(config.cba_apply_offset, update_interval - 1);
+            // A decayed table keeps one history, snapshotted at each seal
+            if (!frequency_buffers[0]->keepsHistory())
+                frequency_buffers[1] = makeFrequencyTable();
+            cba_thread = std::thread(&ReplicaManager::runCBAThread, this);
+        }
+    }
+    if (pipelined)
+    {
+        pipeline_progress.reset(new PipelineProgress[replicas.size()]);
+        for (size_t i = 0; i < replicas.size(); ++i)
+            pipeline_queues.emplace_back(std::make_unique<SpscRing<PipelineRequest>>(PIPELINE_QUEUE_SIZE));
+        for (size_t i = 0; i < replicas.size(); ++i)
+            pipeline_threads.emplace_back(&ReplicaManager::runReplicaPipeline, this, static_cast<int>(i));
     }
 }
 
-ReplicaManager::~ReplicaManager()
+template <typename Policy>
+ReplicaManager<Policy>::~ReplicaManager()
 {
+    if (pipelined)
+    {
+        waitForPipeline(pipeline_dispatched.load(std::memory_order_relaxed));
+        stop_pipeline.store(true, std::memory_order_release);
+        for (auto &thread : pipeline_threads)
+            thread.join();
+    }
     if (enable_cba)
     {
-        stop_cba_thread = true;
+        {
+            std::lock_guard<std::mutex> lock(cba_mutex);
+            stop_cba_thread = true;
+        }
+        cba_cv.notify_all();
         if (cba_thread.joinable())
         {
             cba_thread.join();
@@ -36,91 +134,513 @@ ReplicaManager::~ReplicaManager()
     }
 }
 
-int ReplicaManager::handleRequest(int key, int replica_id)
+template <typename Policy>
+int ReplicaManager<Policy>::handleRequest(int key, int replica_id, int worker)
 {
-    std::lock_guard<std::mutex> lock(manager_mutex);
-    total_requests++;
-    if (total_requests % update_interval == 0 && enable_cba)
+    WorkerState &state = *workers[worker];
+    if (sampler && !(concurrent ? sampler->sample<true>(key, key) : sampler->sample<false>(key, key)))
+        return -1;
+    int primary_replica_id = routeRequest(state, key, replica_id);
+    if (pipelined)
     {
-        if (!is_access_rate_fixed)
+        dispatchRequest(key, primary_replica_id);
+        return -1;
+    }
+    if (concurrent)
+        return processRequest<true>(state, key, primary_replica_id);
+    return processRequest<false>(state, key, primary_replica_id);
+}
+
+template <typename Policy>
+void ReplicaManager<Policy>::handleRequests(const int *keys, size_t count, int worker)
+{
+    WorkerState &state = *workers[worker];
+    if (sampler)
+    {
+        state.sampled_keys.clear();
+        for (size_t i = 0; i < count; ++i)
         {
-            runCBAUpdater();
+            int key;
+            if (concurrent ? sampler->sample<true>(keys[i], key) : sampler->sample<false>(keys[i], key))
+                state.sampled_keys.push_back(key);
         }
-        else
+        keys = state.sampled_keys.data();
+        count = state.sampled_keys.size();
+    }
+    if (pipelined)
+    {
+        for (size_t i = 0; i < count; ++i)
+            dispatchRequest(keys[i], routeRequest(state, keys[i], -1));
+        return;
+    }
+    if (concurrent)
+        processBatch<true>(state, keys, count);
+    else
+        processBatch<false>(state, keys, count);
+}
+
+template <typename Policy>
+template <bool Concurrent>
+void ReplicaManager<Policy>::processBatch(WorkerState &state, const int *keys, size_t count)
+{
+    // Routing draws from the worker's generator in request order, so the
+    // primary replica of each key in the lookahead window is chosen when its
+    // prefetch is issued
+    int routes[PREFETCH_DISTANCE];
+    size_t window = std::min(count, PREFETCH_DISTANCE);
+    for (size_t i = 0; i < window; ++i)
+    {
+        routes[i] = routeRequest(state, keys[i], -1);
+        prefetchRequest(keys[i], routes[i]);
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        size_t slot = i % PREFETCH_DISTANCE;
+        int primary_replica_id = routes[slot];
+        size_t ahead = i + PREFETCH_DISTANCE;
+        if (ahead < count)
+        {
+            routes[slot] = routeRequest(state, keys[ahead], -1);
+            prefetchRequest(keys[ahead], routes[slot]);
+        }
+        processRequest<Concurrent>(state, keys[i], primary_replica_id);
+    }
+}
+
+// Prefetches what serving key on replica touches first: its slot in the
+// replica's cache index and, for the remote lookup on a miss, its directory word
+template <typename Policy>
+void ReplicaManager<Policy>::prefetchRequest(int key, int replica)
+{
+    replicas[replica]->cache->prefetch(key);
+    if (directory)
+        directory->prefetch(key);
+}
+
+// The lowest-numbered other replica caching key, or -1
+template <typename Policy>
+template <bool Concurrent>
+int ReplicaManager<Policy>::findRemote(int key, int primary_replica_id)
+{
+    if (directory)
+    {
+        uint64_t others = directory->holders(key) & ~(1ull << primary_replica_id);
+        return others ? __builtin_ctzll(others) : -1;
+    }
+    int num_replicas = static_cast<int>(replicas.size());
+    for (int i = 0; i < num_replicas; ++i)
+    {
+        if (i == primary_replica_id)
+            continue;
+        auto lock = lockReplica<Concurrent>(i);
+        if (replicas[i]->hasKey(key))
+            return i;
+    }
+    return -1;
+}
+
+template <typename Policy>
+void ReplicaManager<Policy>::recordLatency(WorkerState &state, LatencyOutcome outcome, int replica, uint64_t request, int key)
+{
+    uint64_t latency = latency_model.sample(outcome, request, key);
+    state.outcome_latency[static_cast<int>(outcome)].record(latency);
+    state.latency_ns += latency;
+    state.replica_latency[replica].record(latency);
+}
+
+// The caller holds the replica's lock. The bit is set first so that a put
+// that cannot keep the key clears it again through the eviction callback.
+template <typename Policy>
+void ReplicaManager<Policy>::cacheKey(int replica, int key)
+{
+    if (directory)
+        directory->insert(key, replica);
+    replicas[replica]->cache->put(key, key);
+}
+
+// Splits the directory into word-aligned key ranges, so threads filling the
+// bitmaps in parallel never share a word
+template <typename Policy>
+std::vector<KeyBitmap> ReplicaManager<Policy>::cachedKeys()
+{
+    std::vector<KeyBitmap> keys(replicas.size(), KeyBitmap(dataset_size + 1));
+    auto insert = [&](int key, uint64_t mask)
+    {
+        for (; mask; mask &= mask - 1)
+            keys[__builtin_ctzll(mask)].insert(key);
+    };
+    if (directory)
+    {
+        forEachWordRange(keys[0].bits().size(), [&](size_t begin, size_t end)
+                         { directory->forEachInRange(begin * 64, end * 64, insert); });
+        directory->forEachOutlier(insert);
+        return keys;
+    }
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < replicas.size(); ++i)
+    {
+        threads.emplace_back([&, i]()
+                             {
+            for (int key : replicas[i]->cache->getKeys())
+                keys[i].insert(key); });
+    }
+    for (auto &thread : threads)
+        thread.join();
+    return keys;
+}
+
+template <typename Policy>
+void ReplicaManager<Policy>::dispatchRequest(int key, int primary_replica_id)
+{
+    uint64_t time = pipeline_dispatched.load(std::memory_order_relaxed);
+    // A serial run recomputes the CBA on the request that completes an
+    // interval, before serving it
+    if (enable_cba && (time + 1) % update_interval == 0)
+    {
+        waitForPipeline(time);
+        updateAdmissionSet(time + 1);
+    }
+    pipeline_queues[primary_replica_id]->push(PipelineRequest{key, time});
+    pipeline_dispatched.store(time + 1, std::memory_order_release);
+    if (time + 1 == next_window)
+    {
+        waitForPipeline(time + 1);
+        writeWindow();
+    }
+}
+
+template <typename Policy>
+void ReplicaManager<Policy>::runReplicaPipeline(int replica)
+{
+    WorkerState &state = *workers[replica + 1];
+    SpscRing<PipelineRequest> &queue = *pipeline_queues[replica];
+    std::atomic<uint64_t> &done = pipeline_progress[replica].done;
+    PipelineRequest request;
+    while (true)
+    {
+        if (!queue.tryPop(request))
         {
-            read_cdf_from_file(workload_folder + "freq.txt");
+            // Anything dispatched before this load that was routed here is
+            // already in the queue, so an empty queue means it is all done
+            uint64_t dispatched = pipeline_dispatched.load(std::memory_order_acquire);
+            if (queue.peek())
+                continue;
+            done.store(dispatched, std::memory_order_release);
+            if (stop_pipeline.load(std::memory_order_acquire))
+                return;
+            std::this_thread::yield();
+            continue;
         }
+
+        // Everything before this request that was routed here is served;
+        // the last publication may predate its dispatch
+        done.store(request.time, std::memory_order_release);
+        state.requests++;
+        if (sampled_run)
+            state.stratum_requests[request.key % KeySampler::STRATA]++;
+        serveRequest<true>(state, request.key, replica, request.time);
+        const PipelineRequest *next = queue.peek();
+        done.store(next ? next->time : request.time + 1, std::memory_order_release);
+    }
+}
+
+// Waits until every replica but this one has finished the requests before time
+template <typename Policy>
+void ReplicaManager<Policy>::waitForReplicas(int replica, uint64_t time)
+{
+    for (size_t i = 0; i < replicas.size(); ++i)
+    {
+        while (static_cast<int>(i) != replica && pipeline_progress[i].done.load(std::memory_order_acquire) < time)
+            std::this_thread::yield();
     }
-    int primary_replica_id;
-    if (replica_id == -1)
+}
+
+template <typename Policy>
+void ReplicaManager<Policy>::waitForPipeline(uint64_t time)
+{
+    waitForReplicas(-1, time);
+}
+
+template <typename Policy>
+int ReplicaManager<Policy>::routeRequest(WorkerState &state, int key, int replica_id)
+{
+    return state.router.route(key, replica_id);
+}
+
+template <typename Policy>
+template <bool Concurrent>
+std::unique_lock<std::mutex> ReplicaManager<Policy>::lockReplica(int replica)
+{
+    if constexpr (Concurrent)
+        return std::unique_lock<std::mutex>(replicas[replica]->mutex);
+    else
+        return std::unique_lock<std::mutex>(replicas[replica]->mutex, std::defer_lock);
+}
+
+template <typename Policy>
+template <bool Concurrent>
+bool ReplicaManager<Policy>::reachedUpdateInterval(WorkerState &state)
+{
+    uint64_t request_count;
+    if constexpr (!Concurrent)
     {
-        primary_replica_id = rand() % replicas.size();
+        if (cba_trigger == CBATrigger::Interval)
+            return state.requests % update_interval == 0;
+        if (state.requests % REQUEST_PUBLISH_BATCH != 0)
+            return false;
+        request_count = state.requests;
     }
     else
     {
-        primary_replica_id = replica_id - 1;
+        if (++state.unpublished_requests < REQUEST_PUBLISH_BATCH)
+            return false;
+        state.unpublished_requests = 0;
+        uint64_t before = published_requests.fetch_add(REQUEST_PUBLISH_BATCH, std::memory_order_relaxed);
+        if (cba_trigger == CBATrigger::Interval)
+            return before / update_interval != (before + REQUEST_PUBLISH_BATCH) / update_interval;
+        request_count = before + REQUEST_PUBLISH_BATCH;
+    }
+    published_drift_hits.fetch_add(state.unpublished_drift_hits, std::memory_order_relaxed);
+    state.unpublished_drift_hits = 0;
+    return driftExceeded(request_count);
+}
+
+template <typename Policy>
+bool ReplicaManager<Policy>::driftExceeded(uint64_t request_count)
+{
+    uint64_t last_run = last_cba_request.load(std::memory_order_relaxed);
+    uint64_t since_run = request_count > last_run ? request_count - last_run : 0;
+    if (!drift_keys_published.load(std::memory_order_relaxed))
+        return since_run >= update_interval;
+    if (since_run >= cba_max_interval)
+        return true;
+
+    uint64_t start = drift_window_start.load(std::memory_order_relaxed);
+    uint64_t window = request_count > start ? request_count - start : 0;
+    if (window < cba_min_interval)
+        return false;
+    uint64_t hits = published_drift_hits.load(std::memory_order_relaxed);
+    double coverage = static_cast<double>(hits - std::min(hits, drift_window_hits.load(std::memory_order_relaxed))) / window;
+    double baseline = drift_coverage.load(std::memory_order_relaxed);
+    if (baseline < 0)
+    {
+        drift_coverage.store(coverage, std::memory_order_relaxed);
+        restartDriftWindow(request_count);
+        return false;
+    }
+    if (std::abs(coverage - baseline) > cba_drift_threshold)
+    {
+        std::cout << "Popularity drift at request " << request_count << ": top keys hit by " << coverage
+                  << " of requests, baseline " << baseline << "\n";
+        return true;
+    }
+    restartDriftWindow(request_count);
+    return false;
+}
+
+template <typename Policy>
+void ReplicaManager<Policy>::restartDriftWindow(uint64_t request_count)
+{
+    drift_window_start.store(request_count, std::memory_order_relaxed);
+    drift_window_hits.store(published_drift_hits.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+template <typename Policy>
+template <bool Concurrent>
+int ReplicaManager<Policy>::processRequest(WorkerState &state, int key, int primary_replica_id)
+{
+    state.requests++;
+    if (sampled_run)
+        state.stratum_requests[key % KeySampler::STRATA]++;
+    if (enable_cba && reachedUpdateInterval<Concurrent>(state))
+    {
+        updateAdmissionSet(Concurrent ? published_requests.load(std::memory_order_relaxed) : state.requests);
+    }
+    if (cba_mode != CBAMode::Inline)
+    {
+        pollCBAResult<Concurrent>(state);
+    }
+    int result = serveRequest<Concurrent>(state, key, primary_replica_id, state.requests - 1);
+    if (state.requests == next_window)
+        writeWindow();
+    return result;
+}
+
+// The request itself, after the CBA bookkeeping. In pipeline mode time is the
+// request's position in the trace.
+template <typename Policy>
+template <bool Concurrent>
+int ReplicaManager<Policy>::serveRequest(WorkerState &state, int key, int primary_replica_id, uint64_t time)
+{
+    uint64_t version = admission_version.load(std::memory_order_acquire);
+    if (version != state.admission_version)
+    {
+        state.admitted_keys = std::atomic_load(&admitted_keys);
+        state.drift_keys = std::atomic_load(&drift_keys);
+        state.admission_version = version;
+    }
+    if (state.drift_keys && state.drift_keys->contains(key))
+    {
+        state.unpublished_drift_hits++;
+    }
+
+    int result;
+    {
+        auto lock = lockReplica<Concurrent>(primary_replica_id);
+        result = replicas[primary_replica_id]->processRequest(key);
     }
-    int result = replicas[primary_replica_id]->processRequest(key);
 
     // Track access frequency
-    access_frequencies[key]++;
+    if (FrequencyTable *frequencies = active_frequencies.load(std::memory_order_relaxed))
+    {
+        frequencies->record<Concurrent>(key);
+    }
 
     // Case 1: Key found in primary replica (Hit)
     if (result != -1)
     {
+        state.hits++;
+        recordLatency(state, LatencyOutcome::LocalHit, primary_replica_id, time, key);
         return result;
     }
 
     if (rdma_enabled)
     {
+        if (pipelined)
+            waitForReplicas(primary_replica_id, time);
         // Case 2: Key not found, check other replicas (Remote Fetch)
-        for (int i = 0; i < replicas.size(); ++i)
+        int remote = findRemote<Concurrent>(key, primary_replica_id);
+        if (remote != -1)
         {
-            if (i == primary_replica_id)
-                continue;
+            state.remote_fetches++;
+            state.replica_remote_fetches[remote]++;
+            if (sampled_run)
+                state.stratum_remote_fetches[key % KeySampler::STRATA]++;
 
-            if (replicas[i]->hasKey(key))
+            // CBA checks if this key should be cached locally
+            if (enable_cba && state.admitted_keys->contains(key))
             {
-                total_remote_fetches++;
-                remote_fetches[i]++;
-
-                // CBA checks if this key should be cached locally
-                if (enable_cba)
-                {
-                    if (is_access_rate_fixed)
-                    {
-                        if (shouldCacheLocally(std::to_string(key)))
-                        {
-                            total_keys_admitted++;
-                            replicas[primary_replica_id]->cache->put(key, key);
-                        }
-                    }
-                    else
-                    {
-                        if (cba->shouldCacheLocally(std::to_string(key)))
-                        {
-                            total_keys_admitted++;
-                            replicas[primary_replica_id]->cache->put(key, key);
-                        }
-                    }
-                }
-                return key;
+                state.keys_admitted++;
+                auto lock = lockReplica<Concurrent>(primary_replica_id);
+                cacheKey(primary_replica_id, key);
             }
+            recordLatency(state, LatencyOutcome::RemoteHit, primary_replica_id, time, key);
+            return key;
         }
     }
 
     // Case 3: Key does not exist in any replica (Miss)
-    replicas[primary_replica_id]->cache->put(key, key);
-    total_misses++;
-    replica_misses[primary_replica_id]++;
-    failed_remote_fetches++;
+    {
+        auto lock = lockReplica<Concurrent>(primary_replica_id);
+        cacheKey(primary_replica_id, key);
+    }
+    state.misses++;
+    state.replica_misses[primary_replica_id]++;
+    state.failed_remote_fetches++;
+    if (sampled_run)
+        state.stratum_misses[key % KeySampler::STRATA]++;
+    recordLatency(state, LatencyOutcome::DiskMiss, primary_replica_id, time, key);
     return -1;
 }
 
-void ReplicaManager::computeAndWriteMetrics(const std::string &filename, float cache_pct, int total_dataset_size)
+template <typename Policy>
+void ReplicaManager<Policy>::writeWindowsTo(const std::string &filename)
 {
+    if (metrics_window == 0)
+        return;
+    window_file.open(filename);
+    if (!window_file)
+    {
+        std::cerr << "Error: Unable to open file " << filename << std::endl;
+        return;
+    }
+    window_file << "requests,hits,remote_hits,misses,keys_admitted,avg_latency,r_opt,cached_entries,cached_keys,"
+                   "replication_degree\n";
+    if (directory)
+        directory->countKeys();
+    next_window = metrics_window;
+}
+
+// Writes the counters of the requests since the last row. Sampled runs scale
+// counts to the full trace. Without a directory, distinct keys are not
+// tracked and their columns are 0.
+template <typename Policy>
+void ReplicaManager<Policy>::writeWindow()
+{
+    next_window += metrics_window;
+    if (!window_file)
+        return;
+    WindowTotals totals;
+    for (const auto &state : workers)
+    {
+        totals.requests += state->requests;
+        totals.hits += state->hits;
+        totals.remote_fetches += state->remote_fetches;
+        totals.misses += state->misses;
+        totals.keys_admitted += state->keys_admitted;
+        totals.latency_ns += state->latency_ns;
+    }
+    uint64_t requests = totals.requests - window_start.requests;
+    if (requests == 0)
+        return;
+
+    uint64_t entries = 0, keys = 0;
+    if (directory)
+    {
+        entries = directory->cachedEntries();
+        keys = directory->cachedKeys();
+    }
+    else
+    {
+        for (auto &replica : replicas)
+            entries += replica->cache->size();
+    }
+    uint64_t redundancy = is_access_rate_fixed ? R_opt : (best_optimal_redundancy.empty() ? 0 : best_optimal_redundancy.back());
+    double scale = sampled_run ? 1 / sampler->rate() : 1;
+    auto scaled = [scale](uint64_t count)
+    { return std::llround(count * scale); };
+
+    window_file << scaled(totals.requests) << "," << scaled(totals.hits - window_start.hits) << ","
+                << scaled(totals.remote_fetches - window_start.remote_fetches) << ","
+                << scaled(totals.misses - window_start.misses) << ","
+                << scaled(totals.keys_admitted - window_start.keys_admitted) << ","
+                << static_cast<double>(totals.latency_ns - window_start.latency_ns) / requests / 1000 << ","
+                << scaled(redundancy) << "," << scaled(entries) << "," << scaled(keys) << ","
+                << (keys ? static_cast<double>(entries) / keys : 0) << "\n";
+    window_file.flush();
+    window_start = totals;
+}
+
+template <typename Policy>
+void ReplicaManager<Policy>::computeAndWriteMetrics(const std::string &filename, float cache_pct, int total_dataset_size)
+{
+    if (pipelined)
+        waitForPipeline(pipeline_dispatched.load(std::memory_order_relaxed));
+    // The last, partial window
+    if (window_file.is_open())
+    {
+        writeWindow();
+        window_file.close();
+    }
+    uint64_t total_requests = 0, total_misses = 0, total_remote_fetches = 0, total_keys_admitted = 0, total_latency_ns = 0;
+    std::vector<uint64_t> replica_misses(replicas.size(), 0);
+    for (const auto &state : workers)
+    {
+        total_requests += state->requests;
+        total_latency_ns += state->latency_ns;
+        total_misses += state->misses;
+        total_remote_fetches += state->remote_fetches;
+        total_keys_admitted += state->keys_admitted;
+        for (size_t i = 0; i < replicas.size(); ++i)
+        {
+            replica_misses[i] += state->replica_misses[i];
+        }
+    }
+
     std::vector<float> miss_ratios;
-    for (int misses : replica_misses)
+    for (uint64_t misses : replica_misses)
     {
         miss_ratios.push_back(static_cast<float>(misses) / total_requests);
     }
@@ -130,72 +650,327 @@ void ReplicaManager::computeAndWriteMetrics(const std::string &filename, float c
     float remote_miss_ratio = static_cast<float>(tmp) / overall_miss_ratio;
     float local_miss_ratio = static_cast<float>(total_misses) / total_requests;
 
-    float total_latency = (total_misses * latency_disk) +
-                          (total_remote_fetches * latency_rdma) +
-                          ((total_requests - total_misses - total_remote_fetches) * latency_local);
-
-    float avg_latency = total_latency / total_requests;
+    // The mean of the latencies drawn from latency_model, which the
+    // histograms are built from too
+    float avg_latency = static_cast<double>(total_latency_ns) / total_requests / 1000;
 
     // Store cache contents for metrics tracking
-    for (int i = 0; i < replicas.size(); ++i)
+    std::vector<KeyBitmap> cache_contents = cachedKeys();
+    if (key_shards > 1)
+    {
+        for (size_t i = 0; i < replicas.size(); ++i)
+        {
+            cache_contents[i].forEach([&](int key)
+                                      { shard_contents[i].insert(key * key_shards + key_shard); });
+        }
+        cache_contents = std::move(shard_contents);
+    }
+
+    if (sampled_run)
     {
-        cache_contents[i] = replicas[i]->cache->getKeys();
+        // Admissions are counted in sampled requests
+        total_keys_admitted = std::llround(total_keys_admitted / sampler->rate());
     }
 
     Metrics metrics(cache_contents, cache_pct, total_dataset_size, overall_miss_ratio, remote_miss_ratio, local_miss_ratio, miss_ratios, total_keys_admitted, avg_latency);
+    if (sampled_run)
+    {
+        // Random groups estimate: each stratum of kept keys is itself a
+        // sample, so the spread of the ratios across strata bounds the error
+        // of choosing these keys. Simulating the groups in shared caches
+        // leaves out the error of scaling the capacity down.
+        std::vector<double> requests(KeySampler::STRATA, 0), misses(KeySampler::STRATA, 0), remote_fetches(KeySampler::STRATA, 0);
+        for (const auto &state : workers)
+        {
+            for (int s = 0; s < KeySampler::STRATA; ++s)
+            {
+                requests[s] += state->stratum_requests[s];
+                misses[s] += state->stratum_misses[s];
+                remote_fetches[s] += state->stratum_remote_fetches[s];
+            }
+        }
+        auto interval = [&](auto value)
+        {
+            double total = 0, sum = 0;
+            for (int s = 0; s < KeySampler::STRATA; ++s)
+                total += value(s);
+            double ratio = total / total_requests;
+            for (int s = 0; s < KeySampler::STRATA; ++s)
+                sum += std::pow(value(s) - ratio * requests[s], 2);
+            return static_cast<float>(1.96 * std::sqrt(sum * KeySampler::STRATA / (KeySampler::STRATA - 1)) / total_requests);
+        };
+        metrics.setSampleBounds(sampler->rate(),
+                                interval([&](int s)
+                                         { return misses[s] + remote_fetches[s]; }),
+                                interval([&](int s)
+                                         { return misses[s]; }),
+                                interval([&](int s)
+                                         { return misses[s] * latency_disk + remote_fetches[s] * latency_rdma +
+                                                  (requests[s] - misses[s] - remote_fetches[s]) * latency_local; }));
+    }
+    std::vector<LatencyHistogram> outcome_latency(LATENCY_OUTCOMES), replica_latency(replicas.size());
+    for (const auto &state : workers)
+    {
+        for (int o = 0; o < LATENCY_OUTCOMES; ++o)
+            outcome_latency[o].merge(state->outcome_latency[o]);
+        for (size_t i = 0; i < replicas.size(); ++i)
+            replica_latency[i].merge(state->replica_latency[i]);
+    }
+    metrics.setLatencyHistograms(std::move(outcome_latency), std::move(replica_latency));
     metrics.writeToFile(filename);
+    metrics.writeLatencyHistogramToFile(filename.substr(0, filename.rfind(".txt")) + "_latency.csv");
     std::string modified_filename = "optimal_redundancy_" + filename;
     print_optimal_redundanc_to_file(modified_filename);
 }
 
-void ReplicaManager::runCBAUpdater()
+template <typename Policy>
+void ReplicaManager<Policy>::mergeShard(ReplicaManager &shard)
 {
-    std::vector<std::pair<uint64_t, uint64_t>> sorted_frequencies;
+    for (auto &state : shard.workers)
+        workers.push_back(std::move(state));
+    shard.workers.clear();
+    std::vector<KeyBitmap> shard_keys = shard.cachedKeys();
+    for (size_t i = 0; i < replicas.size(); ++i)
+    {
+        shard_keys[i].forEach([&](int key)
+                              { shard_contents[i].insert(key * key_shards + shard.key_shard); });
+    }
+    // Shards run their CBA intervals at about the same points of the trace,
+    // so the i-th results of all shards add up to the i-th R_opt
+    if (best_optimal_redundancy.size() < shard.best_optimal_redundancy.size())
+        best_optimal_redundancy.resize(shard.best_optimal_redundancy.size(), 0);
+    for (size_t i = 0; i < shard.best_optimal_redundancy.size(); ++i)
+        best_optimal_redundancy[i] += shard.best_optimal_redundancy[i];
+}
 
+template <typename Policy>
+void ReplicaManager<Policy>::updateAdmissionSet(uint64_t request_count)
+{
+    if (cba_trigger == CBATrigger::Drift)
     {
-        if (access_frequencies.empty())
-        {
-            return;
-        }
+        last_cba_request.store(request_count, std::memory_order_relaxed);
+        restartDriftWindow(request_count);
+    }
+    if (cba_mode != CBAMode::Inline)
+    {
+        sealFrequencies(request_count);
+        return;
+    }
 
-        for (const auto &kv : access_frequencies)
-        {
-            sorted_frequencies.emplace_back(kv.second, kv.first);
-        }
+    // Concurrent workers that cross an interval while a recompute is still
+    // running skip it instead of queueing behind it
+    std::unique_lock<std::mutex> lock(cba_mutex, std::try_to_lock);
+    if (!lock.owns_lock())
+        return;
+
+    if (!is_access_rate_fixed)
+    {
+        runCBAUpdater(request_count);
+    }
+    else
+    {
+        read_cdf_from_file(workload_folder + "freq.txt");
+    }
+}
+
+template <typename Policy>
+void ReplicaManager<Policy>::publishAdmissionSet(std::shared_ptr<const AdmissionSet> keys)
+{
+    std::atomic_store(&admitted_keys, std::move(keys));
+    admission_version.fetch_add(1, std::memory_order_release);
+}
+
+// Also replaces the keys drift is measured on and restarts the baseline
+template <typename Policy>
+void ReplicaManager<Policy>::publishAdmissionSet(std::shared_ptr<const AdmissionSet> keys, std::shared_ptr<const AdmissionSet> top_keys, uint64_t request_count)
+{
+    if (top_keys)
+    {
+        std::atomic_store(&drift_keys, std::move(top_keys));
+        drift_coverage.store(-1, std::memory_order_relaxed);
+        restartDriftWindow(request_count);
+        drift_keys_published.store(true, std::memory_order_relaxed);
+    }
+    publishAdmissionSet(std::move(keys));
+}
+
+template <typename Policy>
+FrequencyRanking ReplicaManager<Policy>::rankFrequencies(FrequencyTable &table)
+{
+    auto rank_start = std::chrono::high_resolution_clock::now();
+    FrequencyRanking ranking = table.drain(std::max(1u, std::thread::hardware_concurrency()), concurrent);
+    std::chrono::duration<double> rank_elapsed = std::chrono::high_resolution_clock::now() - rank_start;
+    if (ranking.accessedKeys() > 0)
+    {
+        std::cout << "Time taken to rank access frequencies: " << rank_elapsed.count() << "s\n";
+    }
+    return ranking;
+}
+
+// Runs the optimizer on a ranking; false if nothing was recorded
+template <typename Policy>
+bool ReplicaManager<Policy>::analyzeFrequencies(FrequencyRanking ranking, uint64_t &redundancy, std::shared_ptr<const AdmissionSet> &keys, std::shared_ptr<const AdmissionSet> &top_keys)
+{
+    if (ranking.accessedKeys() == 0)
+    {
+        return false;
+    }
+    if (cba_trigger == CBATrigger::Drift)
+    {
+        std::vector<int> top = ranking.topKeys(std::min(cba_drift_top_k, ranking.accessedKeys()));
+        top_keys = std::make_shared<const AdmissionSet>(AdmissionFilter::Kind::Bitset, std::move(top), dataset_size, 0);
+    }
+    if (ranking.estimate_error > 0)
+    {
+        std::cout << "Sketch estimates: " << ranking.accessedKeys() << " hot keys, each overcounted by at most "
+                  << ranking.estimate_error << " accesses with probability " << 1 - ranking.error_probability << "\n";
+    }
 
-        std::sort(sorted_frequencies.begin(), sorted_frequencies.end(), std::greater<>());
+    cba->updateAccessFrequencies(std::move(ranking));
+    auto start_time = std::chrono::high_resolution_clock::now();
+    redundancy = cba->find_optimal_access_rates();
+    auto end_time = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> elapsed = end_time - start_time;
+    std::cout << "Time taken to compute optimal redundancy: " << elapsed.count() << "s\n";
+    std::vector<int> hot_keys = cba->getReplicatedKeys();
+    keys = std::make_shared<const AdmissionSet>(admission_kind, std::move(hot_keys), dataset_size, admission_bloom_bits_per_key);
+    cba->reset();
+    return true;
+}
 
-        for (uint64_t i = 1; i <= dataset_size; i++)
+template <typename Policy>
+void ReplicaManager<Policy>::runCBAUpdater(uint64_t request_count)
+{
+    uint64_t redundancy;
+    std::shared_ptr<const AdmissionSet> keys;
+    std::shared_ptr<const AdmissionSet> top_keys;
+    if (!analyzeFrequencies(rankFrequencies(*active_frequencies.load()), redundancy, keys, top_keys))
+    {
+        return;
+    }
+    best_optimal_redundancy.push_back(redundancy);
+    publishAdmissionSet(std::move(keys), std::move(top_keys), request_count);
+    if (enable_de_duplication)
+    {
+        deDuplicateCache();
+    }
+}
+
+// Swaps the counter buffers and hands the sealed one to cba_thread. An
+// interval that ends while the previous one is still pending is skipped, and
+// its counts carry over into the next. A decayed table is not swapped but
+// snapshotted here, which is a copy of its already ranked keys.
+template <typename Policy>
+void ReplicaManager<Policy>::sealFrequencies(uint64_t request_count)
+{
+    {
+        std::lock_guard<std::mutex> lock(cba_mutex);
+        if (cba_pending)
+            return;
+        FrequencyTable *sealed = active_frequencies.load(std::memory_order_relaxed);
+        if (sealed->keepsHistory())
         {
-            if (access_frequencies.find(i) == access_frequencies.end())
-            {
-                sorted_frequencies.emplace_back(0, i);
-            }
+            sealed_ranking = std::make_unique<FrequencyRanking>(rankFrequencies(*sealed));
+        }
+        else
+        {
+            active_frequencies.store(sealed == frequency_buffers[0].get() ? frequency_buffers[1].get() : frequency_buffers[0].get(),
+                                     std::memory_order_relaxed);
+            sealed_frequencies = sealed;
         }
-        access_frequencies.clear();
+        cba_pending = true;
+        if (cba_mode == CBAMode::Deterministic)
+            cba_apply_at.store(request_count + cba_apply_offset, std::memory_order_relaxed);
     }
+    cba_cv.notify_all();
+}
 
-    // Update CBA with new frequencies
-    if (enable_cba && cba)
+template <typename Policy>
+template <bool Concurrent>
+void ReplicaManager<Policy>::pollCBAResult(WorkerState &state)
+{
+    uint64_t request_count = Concurrent ? published_requests.load(std::memory_order_relaxed) : state.requests;
+    if (cba_mode == CBAMode::Deterministic)
+    {
+        if (request_count >= cba_apply_at.load(std::memory_order_relaxed))
+            applyCBAResult(request_count);
+    }
+    else if (cba_result_ready.load(std::memory_order_acquire))
     {
-        // std::lock_guard<std::mutex> lock(manager_mutex);
-        cba->updateAccessFrequencies(sorted_frequencies);
-        auto start_time = std::chrono::high_resolution_clock::now();
-        best_optimal_redundancy.push_back(cba->find_optimal_access_rates());
-        auto end_time = std::chrono::high_resolution_clock::now();
-        std::chrono::duration<double> elapsed = end_time - start_time;
-        std::cout << "Time taken to compute optimal redundancy: " << elapsed.count() << "s\n";
-        // std::cout << "Optimal redundancy level: " << best_optimal_redundancy.back() << std::endl;
+        applyCBAResult(request_count);
+    }
+}
+
+// Publishes the pending result on the request path. A Deterministic apply
+// point reached before cba_thread is done waits for it, as do concurrent
+// workers that reach it while another worker applies.
+template <typename Policy>
+void ReplicaManager<Policy>::applyCBAResult(uint64_t request_count)
+{
+    std::unique_lock<std::mutex> lock(cba_mutex);
+    // Re-check under the lock: another worker may have applied the result,
+    // or a newer interval may have been sealed since the caller looked
+    if (!cba_pending)
+        return;
+    if (cba_mode == CBAMode::Deterministic && request_count < cba_apply_at.load(std::memory_order_relaxed))
+        return;
+    if (cba_mode == CBAMode::Async && !cba_result_ready.load(std::memory_order_relaxed))
+        return;
+    uint64_t generation = cba_generation;
+    cba_cv.wait(lock, [this, generation]()
+                { return cba_result_ready.load(std::memory_order_relaxed) || cba_generation != generation; });
+    if (cba_generation != generation)
+        return;
+
+    if (pending_admission)
+    {
+        best_optimal_redundancy.push_back(pending_redundancy);
+        publishAdmissionSet(std::move(pending_admission), std::move(pending_drift_keys), request_count);
+        pending_admission.reset();
+        pending_drift_keys.reset();
         if (enable_de_duplication)
         {
             deDuplicateCache();
         }
     }
-    cba->reset();
-    return;
+    cba_result_ready.store(false, std::memory_order_relaxed);
+    cba_apply_at.store(UINT64_MAX, std::memory_order_relaxed);
+    cba_pending = false;
+    cba_generation++;
+    cba_cv.notify_all();
+}
+
+template <typename Policy>
+void ReplicaManager<Policy>::runCBAThread()
+{
+    std::unique_lock<std::mutex> lock(cba_mutex);
+    while (true)
+    {
+        cba_cv.wait(lock, [this]()
+                    { return stop_cba_thread || sealed_frequencies || sealed_ranking; });
+        if (stop_cba_thread)
+            return;
+        FrequencyTable *sealed = sealed_frequencies;
+        std::unique_ptr<FrequencyRanking> ranking = std::move(sealed_ranking);
+        sealed_frequencies = nullptr;
+        lock.unlock();
+
+        uint64_t redundancy = 0;
+        std::shared_ptr<const AdmissionSet> keys;
+        std::shared_ptr<const AdmissionSet> top_keys;
+        analyzeFrequencies(ranking ? std::move(*ranking) : rankFrequencies(*sealed), redundancy, keys, top_keys);
+
+        lock.lock();
+        pending_redundancy = redundancy;
+        pending_admission = std::move(keys);
+        pending_drift_keys = std::move(top_keys);
+        cba_result_ready.store(true, std::memory_order_release);
+        cba_cv.notify_all();
+    }
 }
 
-void ReplicaManager::read_cdf_from_file(std::string filename)
+template <typename Policy>
+void ReplicaManager<Policy>::read_cdf_from_file(std::string filename)
 {
     std::ifstream file(filename);
     if (!file)
@@ -209,18 +984,30 @@ void ReplicaManager::read_cdf_from_file(std::string filename)
     {
         new_frequencies.emplace_back(freq, key);
     }
+    std::vector<int> keys = std::atomic_load(&admitted_keys)->keys();
     for (uint64_t i = 0; i < R_opt && i < new_frequencies.size(); ++i)
     {
-        dup_keys_map[new_frequencies[i].second] = true;
+        int key = static_cast<int>(new_frequencies[i].second);
+        // A sample admits its share of the R_opt hottest keys
+        if (sampler && !(concurrent ? sampler->sample<true>(key, key) : sampler->sample<false>(key, key)))
+            continue;
+        keys.push_back(key);
     }
+    // Keys stay admitted across intervals, so the hottest keys of this file
+    // are mostly ones already in the set
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    publishAdmissionSet(std::make_shared<const AdmissionSet>(admission_kind, std::move(keys), dataset_size, admission_bloom_bits_per_key));
 }
 
-bool ReplicaManager::shouldCacheLocally(const std::string &key)
+template <typename Policy>
+bool ReplicaManager<Policy>::shouldCacheLocally(int key)
 {
-    return dup_keys_map[std::stoi(key)];
+    return std::atomic_load(&admitted_keys)->contains(key);
 }
 
-void ReplicaManager::print_optimal_redundanc_to_file(std::string filename)
+template <typename Policy>
+void ReplicaManager<Policy>::print_optimal_redundanc_to_file(std::string filename)
 {
     std::ofstream file(filename);
     if (!file)
@@ -229,34 +1016,54 @@ void ReplicaManager::print_optimal_redundanc_to_file(std::string filename)
         return;
     }
 
+    // A sample's R_opt counts sampled keys; report the full-trace equivalent
+    double scale = sampled_run ? 1 / sampler->rate() : 1;
     for (int redundancy : best_optimal_redundancy)
     {
-        file << redundancy << std::endl;
+        file << std::llround(redundancy * scale) << std::endl;
     }
     file.close();
 }
-int ReplicaManager::hashFunction(int key)
+
+template <typename Policy>
+int ReplicaManager<Policy>::hashFunction(int key)
 {
     return key % replicas.size();
 }
 
-void ReplicaManager::deDuplicateCache()
+template <typename Policy>
+void ReplicaManager<Policy>::deDuplicateCache()
 {
-    // std::lock_guard<std::mutex> lock(manager_mutex);
-
-    for (int i = 0; i < replicas.size(); ++i)
+    auto keys = std::atomic_load(&admitted_keys);
+    // With a directory, one pass over it finds every replica's removals
+    std::vector<std::vector<int>> removals(replicas.size());
+    if (directory)
     {
-        std::vector<int> keysToRemove;
-        std::set<int> currentKeys = replicas[i]->cache->getKeys();
-
-        for (int key : currentKeys)
+        directory->forEach([&](int key, uint64_t mask)
+                           {
+            if (enable_cba && keys->contains(key))
+                return;
+            mask &= ~(1ull << hashFunction(key));
+            for (; mask; mask &= mask - 1)
+                removals[__builtin_ctzll(mask)].push_back(key); });
+    }
+    int num_replicas = static_cast<int>(replicas.size());
+    for (int i = 0; i < num_replicas; ++i)
+    {
+        // Workers may still be serving requests when a recompute deduplicates
+        std::lock_guard<std::mutex> lock(replicas[i]->mutex);
+        std::vector<int> &keysToRemove = removals[i];
+        if (!directory)
         {
-            int assigned_replica = hashFunction(key);
-
-            // If this key does not belong to this replica and is not needed anymore, remove it
-            if (assigned_replica != i && !(enable_cba && cba->shouldCacheLocally(std::to_string(key))))
+            for (int key : replicas[i]->cache->getKeys())
             {
-                keysToRemove.push_back(key);
+                int assigned_replica = hashFunction(key);
+
+                // If this key does not belong to this replica and is not needed anymore, remove it
+                if (assigned_replica != i && !(enable_cba && keys->contains(key)))
+                {
+                    keysToRemove.push_back(key);
+                }
             }
         }
 
@@ -267,3 +1074,7 @@ void ReplicaManager::deDuplicateCache()
         }
     }
 }
+
+#define INSTANTIATE_REPLICA_MANAGER(P) template class ReplicaManager<P>;
+FOR_EACH_CACHE_POLICY(INSTANTIATE_REPLICA_MANAGER)
+#undef INSTANTIATE_REPLICA_MANAGER
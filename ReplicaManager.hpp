@@ -6,12 +6,21 @@
 #include "CostBenefitAnalyzer.hpp"
 #include "ConfigManager.hpp"
 #include "CacheBase.hpp"
+#include "AdmissionFilter.hpp"
+#include "KeySampler.hpp"
+#include "SpscRing.hpp"
+#include "Router.hpp"
+#include "KeyDirectory.hpp"
+#include "LatencyHistogram.hpp"
 #include <vector>
 #include <memory>
 #include <mutex>
 #include <map>
 #include <thread>
 #include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <cstdlib>
 
 struct CompareAccessFrequency
 {
@@ -22,51 +31,261 @@ struct CompareAccessFrequency
     }
 };
 
+// Where CBA recomputation runs. Inline stalls the request that crosses an
+// interval; the background modes seal the interval's counters and analyze
+// them on cba_thread. Async applies the result as soon as it is ready,
+// Deterministic exactly cba_apply_offset requests after the interval.
+enum class CBAMode
+{
+    Inline,
+    Async,
+    Deterministic,
+};
+
+// When CBA recomputes. Interval runs it every update_interval requests.
+// Drift watches the share of requests that hit the last analysis's top keys:
+// the first cba_min_interval requests after a result is published set the
+// baseline, and each later window of that size runs CBA if its share moved
+// more than cba_drift_threshold away from it. cba_max_interval requests
+// after a run, it runs regardless.
+enum class CBATrigger
+{
+    Interval,
+    Drift,
+};
+
+// Simulation core, instantiated once per cache policy registered in
+// CachePolicies.hpp so replica cache calls are statically dispatched.
+template <typename Policy>
 class ReplicaManager
 {
 private:
-    std::vector<std::unique_ptr<Replica>> replicas;
+    using AdmissionSet = AdmissionFilter;
+
+    // Per-thread request state. Counters are merged at metrics time, so
+    // concurrent workers only share cache lines through the replicas and the
+    // access counters.
+    struct alignas(64) WorkerState
+    {
+        uint64_t requests = 0;
+        uint64_t unpublished_requests = 0;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t remote_fetches = 0;
+        uint64_t failed_remote_fetches = 0;
+        uint64_t keys_admitted = 0;
+        std::vector<uint64_t> replica_misses;
+        std::vector<uint64_t> replica_remote_fetches;
+        // Latency of each request by outcome and by primary replica
+        LatencyHistogram outcome_latency[LATENCY_OUTCOMES];
+        std::vector<LatencyHistogram> replica_latency;
+        uint64_t latency_ns = 0;
+        std::shared_ptr<const AdmissionSet> admitted_keys;
+        std::shared_ptr<const AdmissionSet> drift_keys;
+        uint64_t unpublished_drift_hits = 0;
+        uint64_t admission_version = 0;
+        // Private router, so managers running side by side route exactly as
+        // a lone run would
+        Router router;
+        // Sampled runs: the kept keys of the current batch, renumbered, and
+        // outcomes per stratum of kept keys
+        std::vector<int> sampled_keys;
+        std::vector<uint64_t> stratum_requests;
+        std::vector<uint64_t> stratum_remote_fetches;
+        std::vector<uint64_t> stratum_misses;
+    };
+
+
+    // Concurrent workers add their request counts to published_requests in
+    // batches of this size to decide when a CBA interval has passed
+    static constexpr uint64_t REQUEST_PUBLISH_BATCH = 1024;
+    // How many requests ahead handleRequests prefetches cache index slots and
+    // directory words
+    static constexpr size_t PREFETCH_DISTANCE = 16;
+
+    std::vector<std::unique_ptr<Replica<Policy>>> replicas;
+    // Holders of every cached key, kept by the caches' eviction callbacks;
+    // null with more than KeyDirectory::MAX_REPLICAS replicas, which probe
+    // each other instead
+    std::unique_ptr<KeyDirectory> directory;
+    std::vector<std::unique_ptr<WorkerState>> workers;
     uint64_t dataset_size;
-    std::mutex manager_mutex;
-    uint64_t total_requests = 0;
-    uint64_t total_misses = 0;
-    uint64_t total_remote_fetches = 0;
-    uint64_t failed_remote_fetches = 0;
-    uint64_t total_hits = 0;
-    uint64_t total_keys_admitted = 0;
+    bool concurrent = false;
+    std::atomic<uint64_t> published_requests{0};
     bool rdma_enabled = false;
     bool enable_cba = false;
     bool enable_de_duplication = false;
     bool is_access_rate_fixed = false;
     uint64_t R_opt = 0;
     std::unique_ptr<CostBenefitAnalyzer> cba;
-    std::vector<int> replica_misses;
-    std::vector<int> remote_fetches;
-    std::vector<std::set<int>> cache_contents;
-    std::map<int, uint64_t> access_frequencies;
+    CBAMode cba_mode = CBAMode::Inline;
+    uint64_t cba_apply_offset = 0;
+    // Per-key access counts. Requests record into active_frequencies; the
+    // background modes swap in the other buffer at each interval and hand the
+    // sealed one to cba_thread
+    std::unique_ptr<FrequencyTable> frequency_buffers[2];
+    std::atomic<FrequencyTable *> active_frequencies{nullptr};
     std::atomic<bool> stop_cba_thread;
     std::thread cba_thread;
+    std::mutex cba_mutex;
+    std::condition_variable cba_cv;
+    // Guarded by cba_mutex: the buffer (or decayed snapshot) waiting for
+    // cba_thread, whether an interval has been sealed but not yet applied,
+    // the number of results applied so far, and the finished result
+    FrequencyTable *sealed_frequencies = nullptr;
+    std::unique_ptr<FrequencyRanking> sealed_ranking;
+    bool cba_pending = false;
+    uint64_t cba_generation = 0;
+    uint64_t pending_redundancy = 0;
+    std::shared_ptr<const AdmissionSet> pending_admission;
+    std::shared_ptr<const AdmissionSet> pending_drift_keys;
+    std::atomic<bool> cba_result_ready{false};
+    // Request count at which a Deterministic result is applied
+    std::atomic<uint64_t> cba_apply_at{UINT64_MAX};
     uint64_t update_interval;
     std::vector<int> best_optimal_redundancy;
-    std::map<int, bool> dup_keys_map;
+    // Keys replicas admit on a remote hit; published with std::atomic_store
+    // and picked up by each worker when admission_version changes
+    std::shared_ptr<const AdmissionSet> admitted_keys;
+    std::atomic<uint64_t> admission_version{0};
+    CBATrigger cba_trigger = CBATrigger::Interval;
+    uint64_t cba_min_interval = 0;
+    uint64_t cba_max_interval = 0;
+    double cba_drift_threshold = 0;
+    uint64_t cba_drift_top_k = 0;
+    // The last analysis's top keys, published with admitted_keys. Workers
+    // count requests hitting them and add the counts to published_drift_hits
+    // in batches. drift_coverage is negative until the baseline is measured.
+    std::shared_ptr<const AdmissionSet> drift_keys;
+    std::atomic<bool> drift_keys_published{false};
+    std::atomic<double> drift_coverage{-1};
+    std::atomic<uint64_t> published_drift_hits{0};
+    std::atomic<uint64_t> last_cba_request{0};
+    std::atomic<uint64_t> drift_window_start{0};
+    std::atomic<uint64_t> drift_window_hits{0};
+    AdmissionFilter::Kind admission_kind = AdmissionFilter::Kind::Bitset;
+    unsigned admission_bloom_bits_per_key = 0;
     uint64_t latency_local;
     uint64_t latency_rdma;
     uint64_t latency_disk;
+    LatencyModel latency_model;
     std::string workload_folder;
     std::string cache_type;
+    // Pipeline mode: each replica is served by its own thread, fed in trace
+    // order through its queue by the caller of handleRequest(s), which routes
+    // with workers[0]. Replica r's thread uses workers[r + 1] and publishes in
+    // pipeline_progress[r] the position of the earliest request it has not
+    // finished. Only a replica's own misses and admissions change its keys,
+    // so a thread serves hits without waiting; on a miss it waits until every
+    // other replica is done with the requests before it, which is the state a
+    // serial run would query. CBA runs between requests once all threads have
+    // caught up, so results match a serial run exactly.
+    struct PipelineRequest
+    {
+        int key;
+        uint64_t time;
+    };
+    struct alignas(64) PipelineProgress
+    {
+        std::atomic<uint64_t> done{0};
+    };
+    static constexpr size_t PIPELINE_QUEUE_SIZE = 4096;
+    bool pipelined = false;
+    std::vector<std::unique_ptr<SpscRing<PipelineRequest>>> pipeline_queues;
+    std::unique_ptr<PipelineProgress[]> pipeline_progress;
+    std::atomic<uint64_t> pipeline_dispatched{0};
+    std::atomic<bool> stop_pipeline{false};
+    std::vector<std::thread> pipeline_threads;
+    // Set when only a sample or a shard of the keys is simulated. A sampled
+    // run reports its rate and error bounds; a shard is merged into shard 0,
+    // which reports for the whole trace, its keys numbered key * key_shards +
+    // key_shard to keep shards apart.
+    std::unique_ptr<KeySampler> sampler;
+    bool sampled_run = false;
+    int key_shards = 1;
+    int key_shard = 0;
+    std::vector<KeyBitmap> shard_contents;
+    // Time series: a row of counters every metrics_window requests, cut
+    // between requests by the single worker or, in pipeline mode, by the
+    // dispatcher once the replica threads have caught up
+    struct WindowTotals
+    {
+        uint64_t requests = 0;
+        uint64_t hits = 0;
+        uint64_t remote_fetches = 0;
+        uint64_t misses = 0;
+        uint64_t keys_admitted = 0;
+        uint64_t latency_ns = 0;
+    };
+    uint64_t metrics_window = 0;
+    uint64_t next_window = 0;
+    WindowTotals window_start;
+    std::ofstream window_file;
 
-    void runCBAUpdater();
+    int routeRequest(WorkerState &state, int key, int replica_id);
+    template <bool Concurrent>
+    int processRequest(WorkerState &state, int key, int primary_replica_id);
+    template <bool Concurrent>
+    int serveRequest(WorkerState &state, int key, int primary_replica_id, uint64_t time);
+    void dispatchRequest(int key, int primary_replica_id);
+    void runReplicaPipeline(int replica);
+    void waitForReplicas(int replica, uint64_t time);
+    void waitForPipeline(uint64_t time);
+    template <bool Concurrent>
+    int findRemote(int key, int primary_replica_id);
+    void cacheKey(int replica, int key);
+    void writeWindow();
+    // request is the position of the request in the trace
+    void recordLatency(WorkerState &state, LatencyOutcome outcome, int replica, uint64_t request, int key);
+    // Keys cached by each replica, over [0, dataset_size]
+    std::vector<KeyBitmap> cachedKeys();
+    void prefetchRequest(int key, int replica);
+    template <bool Concurrent>
+    void processBatch(WorkerState &state, const int *keys, size_t count);
+    template <bool Concurrent>
+    bool reachedUpdateInterval(WorkerState &state);
+    template <bool Concurrent>
+    std::unique_lock<std::mutex> lockReplica(int replica);
+    void updateAdmissionSet(uint64_t request_count);
+    void publishAdmissionSet(std::shared_ptr<const AdmissionSet> keys);
+    void publishAdmissionSet(std::shared_ptr<const AdmissionSet> keys, std::shared_ptr<const AdmissionSet> top_keys, uint64_t request_count);
+    bool driftExceeded(uint64_t request_count);
+    void restartDriftWindow(uint64_t request_count);
+    void runCBAUpdater(uint64_t request_count);
+    FrequencyRanking rankFrequencies(FrequencyTable &table);
+    bool analyzeFrequencies(FrequencyRanking ranking, uint64_t &redundancy, std::shared_ptr<const AdmissionSet> &keys, std::shared_ptr<const AdmissionSet> &top_keys);
+    void sealFrequencies(uint64_t request_count);
+    template <bool Concurrent>
+    void pollCBAResult(WorkerState &state);
+    void applyCBAResult(uint64_t request_count);
+    void runCBAThread();
 
 public:
     ReplicaManager(ConfigManager &config);
     ~ReplicaManager();
-    int handleRequest(int key, int replica_id = -1);
+    // Replicas are only locked once concurrent callers are announced; the
+    // single-threaded path runs without locking.
+    void setConcurrent(bool value) { concurrent = value; }
+    int workerCount() const { return static_cast<int>(workers.size()); }
+    // worker selects the caller's per-thread state; concurrent callers must
+    // each use a distinct worker in [0, workerCount())
+    // Requests to keys outside a sample are dropped and return -1
+    int handleRequest(int key, int replica_id = -1, int worker = 0);
+    // Same as calling handleRequest(key, -1, worker) for each key in order,
+    // with the primary replica's index slot and the key's directory word
+    // prefetched a window ahead
+    void handleRequests(const int *keys, size_t count, int worker = 0);
+    // Adds a shard's counters, cache contents and R_opt history to this
+    // one's, after both have replayed their requests
+    void mergeShard(ReplicaManager &shard);
+    // Starts writing the time series to filename, before any request
+    void writeWindowsTo(const std::string &filename);
     void computeAndWriteMetrics(const std::string &filename, float cache_pct, int total_dataset_size);
     void print_optimal_redundanc_to_file(std::string filename);
     int hashFunction(int key);
     void deDuplicateCache();
     void read_cdf_from_file(std::string filename);
-    bool shouldCacheLocally(const std::string &key);
+    bool shouldCacheLocally(int key);
 };
 
 #endif // REPLICA_MANAGER_HPP
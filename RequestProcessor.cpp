@@ -1,20 +1,22 @@
 #include "RequestProcessor.hpp"
-#include <fstream>
+#include "TraceFormat.hpp"
+#include "TraceStream.hpp"
 #include <iostream>
-#include <sstream>
 #include <thread>
 #include <atomic>
 #include <vector>
 #include <filesystem>
 #include <regex>
-#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
 
 namespace fs = std::filesystem;
-extern std::atomic<int> completed_requests;
+extern std::atomic<uint64_t> completed_requests;
 
 void displayProgressBar(uint64_t total_requests)
 {
@@ -42,166 +44,141 @@ void displayProgressBar(uint64_t total_requests)
     std::cout << "[==================================================] 100%\n";
 }
 
-// Regex pattern to validate file format
-bool RequestProcessor::isValidFileFormat(const std::string &filename)
+// Key-only trace written by the trace generators, one key per line
+bool RequestProcessor::isTraceFile(const std::string &filename)
 {
-    // std::regex pattern(R"(client_\d+_thread_\d+\_clientPerThread_\d+\.txt)");
-    std::regex pattern(R"(seq.txt)");
+    std::regex pattern(R"(seq\.txt)");
     return std::regex_match(filename, pattern);
 }
 
-RequestProcessor::RequestProcessor(const std::string &folder) : folder_path(folder) {}
-
-// Load requests from a file into a vector
-std::vector<std::pair<int, int>> RequestProcessor::loadRequestsFromFile(const std::string &file_path)
+// Client file with "key replica op" lines
+bool RequestProcessor::isClientFile(const std::string &filename)
 {
-    std::vector<std::pair<int, int>> requests;
-    std::ifstream file(file_path);
-    int total_requests = 0;
-    if (!file)
-    {
-        std::cerr << "Error: Could not open file " << file_path << "\n";
-        return requests;
-    }
-
-    std::string line;
-    while (std::getline(file, line))
-    {
-        std::istringstream iss(line);
-        int key, replica;
-        std::string operation; // Ignore this column
+    std::regex pattern(R"(client_\d+_thread_\d+_clientPerThread_\d+\.txt)");
+    return std::regex_match(filename, pattern);
+}
 
-        if (!(iss >> key >> replica >> operation))
-        {
-            std::cerr << "Warning: Invalid format in file " << file_path << ": " << line << "\n";
-            continue;
-        }
+RequestProcessor::RequestProcessor(const std::string &folder, size_t stream_memory_budget)
+    : folder_path(folder), stream_memory_budget(stream_memory_budget) {}
 
-        requests.emplace_back(key, replica);
-        // if (requests.size() >= 100000)
-        //     break;
-    }
-    file.close();
-    std::cout << "Loaded " << requests.size() << " requests from " << file_path << "\n";
-    return requests;
+static unsigned hardwareThreads()
+{
+    return std::max(1u, std::thread::hardware_concurrency());
 }
 
-std::vector<std::pair<int, int>> RequestProcessor::loadRequestsFromTracesFile(const std::string &file_path)
+// Maps a text trace and parses it on parse_threads threads
+static ParsedTrace loadTextTrace(const std::string &file_path, unsigned parse_threads, bool with_replicas)
 {
-    std::vector<std::pair<int, int>> requests;
-
     int fd = open(file_path.c_str(), O_RDONLY);
     if (fd == -1)
     {
         std::cerr << "Error: Could not open file " << file_path << "\n";
-        return requests;
+        return {};
     }
 
-    // off_t file_size = lseek(fd, 0, SEEK_END);
     struct stat sb;
     if (fstat(fd, &sb) == -1)
     {
         std::cerr << "Error: fstat failed\n";
         close(fd);
-        return requests;
+        return {};
+    }
+    size_t file_size = sb.st_size;
+    if (file_size == 0)
+    {
+        close(fd);
+        return {};
     }
-    off_t file_size = sb.st_size;
 
-    char *data = static_cast<char *>(mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0));
+    char *data = static_cast<char *>(mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0));
     close(fd);
 
     if (data == MAP_FAILED)
     {
         std::cerr << "Error: Memory mapping failed: " << strerror(errno) << "\n";
-        return requests;
+        return {};
     }
 
-    madvise(data, file_size, MADV_SEQUENTIAL | MADV_WILLNEED);
-
-    requests.resize(file_size);
-
-    char *ptr = data;
-    char *end = data + file_size;
-    size_t index = 0;
-
-    const size_t PROGRESS_STEP = file_size / 100; // Update progress every 1% read
-    size_t next_progress = PROGRESS_STEP;         // Next update threshold
-
-    while (ptr < end)
-    {
-        char *line_start = ptr;
-        ptr = static_cast<char *>(memchr(ptr, '\n', end - ptr));
-
-        if (!ptr || ptr >= end)
-            break;
-
-        *ptr++ = '\0';
-
-        char *end_ptr;
-        unsigned long long key = std::strtoull(line_start, &end_ptr, 10);
-
-        if (line_start == end_ptr)
-            continue;
-
-        requests[index++] = {static_cast<int>(key), 0};
-
-        // **Update progress bar**
-        if (ptr - data >= next_progress)
-        {
-            int percentage = static_cast<int>((ptr - data) * 100 / file_size);
-            std::cout << "\r[";
-            int bar_width = 50; // Progress bar width
-            int pos = bar_width * percentage / 100;
-
-            for (int i = 0; i < bar_width; ++i)
-                std::cout << (i < pos ? '#' : ' ');
-
-            std::cout << "] " << percentage << "%";
-            std::cout.flush();
-
-            next_progress += PROGRESS_STEP;
-        }
-    }
-
-    requests.resize(index);
+    madvise(data, file_size, MADV_WILLNEED);
+    ParsedTrace parsed = parseTextTrace(data, file_size, parse_threads, with_replicas);
     munmap(data, file_size);
+    return parsed;
+}
 
-    std::cout << "\nLoaded " << requests.size() << " requests from " << file_path << " using optimized mmap()\n";
+// Load "key replica op" requests from a client file
+ParsedTrace RequestProcessor::loadRequestsFromFile(const std::string &file_path, unsigned parse_threads)
+{
+    ParsedTrace requests = loadTextTrace(file_path, parse_threads, true);
+    if (requests.invalid_lines > 0)
+        std::cerr << "Warning: Skipped " << requests.invalid_lines << " lines with invalid format in file " << file_path << "\n";
+    std::cout << "Loaded " << requests.keys.size() << " requests from " << file_path << "\n";
     return requests;
 }
 
-// Process all valid files in the folder in parallel
-void RequestProcessor::processAllFilesParallel(ReplicaManager &manager)
+// Load the leading key of every line of a trace
+std::vector<int> RequestProcessor::loadRequestsFromTracesFile(const std::string &file_path, unsigned parse_threads)
 {
-    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<int> requests = loadTextTrace(file_path, parse_threads, false).keys;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Loaded " << requests.size() << " requests from " << file_path << " in " << seconds << " s on "
+              << parse_threads << " threads\n";
+    return requests;
+}
 
+// Process all client files in the folder in parallel, one file at a time per
+// worker. A folder without client files has its key-only trace split into
+// batches across the workers instead.
+template <typename Policy>
+void RequestProcessor::processAllFilesParallel(ReplicaManager<Policy> &manager)
+{
+    std::vector<std::string> files;
     for (const auto &entry : fs::directory_iterator(folder_path))
     {
         if (entry.is_regular_file())
         {
-            std::string file_path = entry.path().string();
             std::string filename = entry.path().filename().string();
 
-            if (!isValidFileFormat(filename))
+            if (!isClientFile(filename))
             {
-                std::cerr << "Skipping invalid file: " << filename << "\n";
+                if (!isTraceFile(filename))
+                    std::cerr << "Skipping invalid file: " << filename << "\n";
                 continue;
             }
+            files.push_back(entry.path().string());
+        }
+    }
 
-            // Launch a new thread for each valid file
-            threads.emplace_back([&, file_path]()
-                                 {
-                std::vector<std::pair<int, int>> requests = loadRequestsFromFile(file_path);
-                
-                for (const auto &[key, replica] : requests)
-                {
+    if (files.empty())
+    {
+        std::cerr << "Warning: No client files in " << folder_path << "; splitting its trace across workers\n";
+        processTraceParallel(manager);
+        return;
+    }
+
+    std::vector<std::thread> threads;
+    std::atomic<size_t> next_file(0);
+    int num_workers = static_cast<int>(std::min<size_t>(manager.workerCount(), files.size()));
+    manager.setConcurrent(true);
+    // Workers already run side by side, so each parses with its share of the cores
+    unsigned parse_threads = std::max(1u, hardwareThreads() / std::max(num_workers, 1));
+
+    for (int worker = 0; worker < num_workers; ++worker)
+    {
+        threads.emplace_back([&, worker]()
+                             {
+            for (size_t i = next_file++; i < files.size(); i = next_file++)
+            {
+                ParsedTrace requests = loadRequestsFromFile(files[i], parse_threads);
 
-                    manager.handleRequest(key, replica);
-                    completed_requests++;
+                for (size_t r = 0; r < requests.keys.size(); ++r)
+                {
+                    manager.handleRequest(requests.keys[r], requests.replicas[r], worker);
                 }
-                
-                std::cout << "Completed processing file: " << file_path << "\n"; });
-        }
+                completed_requests += requests.keys.size();
+
+                std::cout << "Completed processing file: " << files[i] << "\n";
+            } });
     }
 
     // Wait for all threads to finish
@@ -213,39 +190,154 @@ void RequestProcessor::processAllFilesParallel(ReplicaManager &manager)
     std::cout << "All files processed\n";
 }
 
-// Process only the first valid file in the folder
-void RequestProcessor::processFirstFile(ReplicaManager &manager)
+// Replays the first trace on workerCount() workers, each taking the next
+// REQUEST_BATCH_SIZE requests in turn
+template <typename Policy>
+void RequestProcessor::processTraceParallel(ReplicaManager<Policy> &manager)
+{
+    LoadedTrace trace;
+    if (!loadFirstFile(trace))
+        return;
+
+    const int *keys = trace.keys();
+    size_t count = trace.size();
+    std::thread progress_thread(displayProgressBar, count);
+    std::vector<std::thread> threads;
+    std::atomic<size_t> next_batch(0);
+    manager.setConcurrent(true);
+
+    for (int worker = 0; worker < manager.workerCount(); ++worker)
+    {
+        threads.emplace_back([&, worker]()
+                             {
+            for (size_t offset = next_batch.fetch_add(REQUEST_BATCH_SIZE); offset < count;
+                 offset = next_batch.fetch_add(REQUEST_BATCH_SIZE))
+            {
+                size_t batch = std::min(REQUEST_BATCH_SIZE, count - offset);
+                manager.handleRequests(keys + offset, batch, worker);
+                completed_requests += batch;
+            } });
+    }
+
+    for (auto &t : threads)
+        t.join();
+    progress_thread.join();
+    std::cout << "Completed processing file: " << trace.path << "\n";
+}
+
+template <typename Policy>
+void RequestProcessor::replayKeys(ReplicaManager<Policy> &manager, const int *keys, size_t count)
+{
+    std::thread progress_thread(displayProgressBar, count);
+
+    for (size_t offset = 0; offset < count; offset += REQUEST_BATCH_SIZE)
+    {
+        size_t batch = std::min(REQUEST_BATCH_SIZE, count - offset);
+        manager.handleRequests(keys + offset, batch);
+        completed_requests += batch;
+    }
+    progress_thread.join();
+}
+
+template <typename Policy>
+void RequestProcessor::streamKeys(ReplicaManager<Policy> &manager, const std::string &file_path)
+{
+    TraceStream stream(file_path, stream_memory_budget);
+    uint64_t streamed = 0;
+    while (const TraceChunk *chunk = stream.next())
+    {
+        for (size_t offset = 0; offset < chunk->count; offset += REQUEST_BATCH_SIZE)
+        {
+            size_t batch = std::min(REQUEST_BATCH_SIZE, chunk->count - offset);
+            manager.handleRequests(chunk->keys.data() + offset, batch);
+        }
+        streamed += chunk->count;
+        completed_requests += chunk->count;
+    }
+    std::cout << "Streamed " << streamed << " requests from " << file_path << "\n";
+}
+
+template <typename Policy>
+void RequestProcessor::replayShared(ReplicaManager<Policy> &manager, const LoadedTrace &trace)
+{
+    for (size_t offset = 0; offset < trace.size(); offset += REQUEST_BATCH_SIZE)
+    {
+        size_t batch = std::min(REQUEST_BATCH_SIZE, trace.size() - offset);
+        manager.handleRequests(trace.keys() + offset, batch);
+        completed_requests += batch;
+    }
+}
+
+// The folder's key-only text trace, or empty if there is none
+std::string RequestProcessor::firstTraceFile()
 {
-    // uint64_t total_requests = 0;
     for (const auto &entry : fs::directory_iterator(folder_path))
     {
         if (entry.is_regular_file())
         {
-            std::string file_path = entry.path().string();
             std::string filename = entry.path().filename().string();
-
-            if (!isValidFileFormat(filename))
+            if (!isTraceFile(filename))
             {
-                std::cerr << "Skipping invalid file: " << filename << "\n";
+                if (!isClientFile(filename))
+                    std::cerr << "Skipping invalid file: " << filename << "\n";
                 continue;
             }
+            return entry.path().string();
+        }
+    }
+    std::cerr << "Error: No seq.txt or seq.bin in " << folder_path << "\n";
+    return "";
+}
 
-            std::vector<std::pair<int, int>> requests = loadRequestsFromTracesFile(file_path);
-            std::thread progress_thread(displayProgressBar, requests.size());
-
-            for (const auto &[key, replica] : requests)
-            {
-                // if (total_requests % 1000000 == 0)
-                // {
-                //     std::cout << "keys: " << key << "\n";
-                // }
-                // total_requests++;
-                manager.handleRequest(key);
-                completed_requests++;
-            }
-            progress_thread.join();
-            std::cout << "Completed processing file: " << file_path << "\n";
-            break; // Process only the first valid file and exit
+bool RequestProcessor::loadFirstFile(LoadedTrace &trace)
+{
+    // A converted binary trace is replayed straight from the mapping
+    fs::path binary_path = fs::path(folder_path) / "seq.bin";
+    if (fs::is_regular_file(binary_path) && isBinaryTrace(binary_path.string()) && trace.mapped.open(binary_path.string()))
+    {
+        if (!trace.mapped.keys())
+        {
+            std::cerr << "Error: " << binary_path.string() << " has 64-bit keys; remap them to dense IDs first\n";
+            return false;
         }
+        trace.path = binary_path.string();
+        std::cout << "Mapped " << trace.size() << " requests from " << trace.path << "\n";
+        return true;
+    }
+
+    trace.path = firstTraceFile();
+    if (trace.path.empty())
+        return false;
+    trace.parsed = loadRequestsFromTracesFile(trace.path, hardwareThreads());
+    return true;
+}
+
+// Process only the first valid file in the folder, preferring seq.bin
+template <typename Policy>
+void RequestProcessor::processFirstFile(ReplicaManager<Policy> &manager)
+{
+    fs::path binary_path = fs::path(folder_path) / "seq.bin";
+    bool binary = fs::is_regular_file(binary_path) && isBinaryTrace(binary_path.string());
+    if (stream_memory_budget > 0 && !binary)
+    {
+        std::string file_path = firstTraceFile();
+        if (file_path.empty())
+            return;
+        streamKeys(manager, file_path);
+        std::cout << "Completed processing file: " << file_path << "\n";
+        return;
     }
-}
\ No newline at end of file
+
+    LoadedTrace trace;
+    if (!loadFirstFile(trace))
+        return;
+    replayKeys(manager, trace.keys(), trace.size());
+    std::cout << "Completed processing file: " << trace.path << "\n";
+}
+
+#define INSTANTIATE_REQUEST_PROCESSOR(P)                                                 \
+    template void RequestProcessor::processAllFilesParallel(ReplicaManager<P> &manager);   \
+    template void RequestProcessor::processFirstFile(ReplicaManager<P> &manager);          \
+    template void RequestProcessor::replayShared(ReplicaManager<P> &manager, const LoadedTrace &trace);
+FOR_EACH_CACHE_POLICY(INSTANTIATE_REQUEST_PROCESSOR)
+#undef INSTANTIATE_REQUEST_PROCESSOR
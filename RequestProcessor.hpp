@@ -2,26 +2,64 @@
 #define REQUEST_PROCESSOR_HPP
 
 #include "ReplicaManager.hpp"
+#include "TraceParser.hpp"
+#include "TraceFormat.hpp"
 #include <string>
 #include <vector>
 #include <filesystem>
 #include <regex>
 
+// A whole trace held for replay: a mapped seq.bin or a parsed text file
+struct LoadedTrace
+{
+    MappedTrace mapped;
+    std::vector<int> parsed;
+    std::string path;
+
+    const int *keys() const { return parsed.empty() ? mapped.keys() : parsed.data(); }
+    size_t size() const { return parsed.empty() ? mapped.size() : parsed.size(); }
+};
+
 class RequestProcessor
 {
 private:
+    // Requests handed to ReplicaManager::handleRequests per call
+    static constexpr size_t REQUEST_BATCH_SIZE = 4096;
+
     std::string folder_path;
+    size_t stream_memory_budget;
     uint64_t total_requests = 0;
 
-    bool isValidFileFormat(const std::string &filename);
-    std::vector<std::pair<int, int>> loadRequestsFromFile(const std::string &file_path);
-    std::vector<std::pair<int, int>> loadRequestsFromTracesFile(const std::string &file_path);
+    bool isTraceFile(const std::string &filename);
+    bool isClientFile(const std::string &filename);
+    ParsedTrace loadRequestsFromFile(const std::string &file_path, unsigned parse_threads);
+    std::vector<int> loadRequestsFromTracesFile(const std::string &file_path, unsigned parse_threads);
+    std::string firstTraceFile();
+    template <typename Policy>
+    void processTraceParallel(ReplicaManager<Policy> &manager);
+    template <typename Policy>
+    void replayKeys(ReplicaManager<Policy> &manager, const int *keys, size_t count);
+    template <typename Policy>
+    void streamKeys(ReplicaManager<Policy> &manager, const std::string &file_path);
 
 public:
-    RequestProcessor(const std::string &folder);
+    // A non-zero stream_memory_budget (bytes) streams text traces through a
+    // bounded chunk pool instead of loading them whole
+    RequestProcessor(const std::string &folder, size_t stream_memory_budget = 0);
 
-    void processAllFilesParallel(ReplicaManager &manager);
-    void processFirstFile(ReplicaManager &manager);
+    template <typename Policy>
+    void processAllFilesParallel(ReplicaManager<Policy> &manager);
+    template <typename Policy>
+    void processFirstFile(ReplicaManager<Policy> &manager);
+    // Maps seq.bin or loads the first valid text file, as processFirstFile
+    // replays it; false if there is no usable trace
+    bool loadFirstFile(LoadedTrace &trace);
+    // Replays a trace that other managers may be replaying at the same time
+    template <typename Policy>
+    static void replayShared(ReplicaManager<Policy> &manager, const LoadedTrace &trace);
 };
 
+// Draws a progress bar until completed_requests reaches total_requests
+void displayProgressBar(uint64_t total_requests);
+
 #endif // REQUEST_PROCESSOR_HPP
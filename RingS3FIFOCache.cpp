@@ -0,0 +1,253 @@
+#include "RingS3FIFOCache.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+    uint64_t mixKey(int key)
+    {
+        // splitmix64 finalizer
+        uint64_t x = static_cast<uint32_t>(key);
+        x += 0x9E3779B97F4A7C15ull;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+        return x ^ (x >> 31);
+    }
+}
+
+uint32_t RingS3FIFOCache::Ring::push(int key)
+{
+    uint32_t pos = static_cast<uint32_t>(head);
+    keys[head] = key;
+    if (++head == keys.size())
+        head = 0;
+    count++;
+    return pos;
+}
+
+int RingS3FIFOCache::Ring::pop()
+{
+    int key = keys[tail];
+    if (++tail == keys.size())
+        tail = 0;
+    count--;
+    return key;
+}
+
+RingS3FIFOCache::RingS3FIFOCache(size_t cap, double fifo_ratio, double ghost_ratio, int threshold)
+    : capacity(cap), promote_freq(static_cast<uint32_t>(std::max(threshold - 1, 0))), index(cap)
+{
+    if (cap >= POS_MASK)
+    {
+        throw std::invalid_argument("RingS3FIFOCache capacity too large: " + std::to_string(cap));
+    }
+
+    size_t small_size = cap ? std::max<size_t>(1, static_cast<size_t>(cap * fifo_ratio)) : 0;
+    small_fifo.keys.resize(small_size);
+    main_fifo.keys.resize(cap - small_size);
+
+    ghost_size = static_cast<uint32_t>(cap * ghost_ratio);
+    if (ghost_size > 0)
+    {
+        // Size buckets for ~6 live fingerprints out of GHOST_WAYS slots
+        size_t buckets = 1;
+        while (buckets * 6 < ghost_size)
+            buckets <<= 1;
+        ghost_table.assign(buckets * GHOST_WAYS, GhostEntry{0, 0});
+        ghost_bucket_mask = buckets - 1;
+    }
+}
+
+int RingS3FIFOCache::get(int key)
+{
+    FlatKeyIndex::Slot &slot = index[index.find(key)];
+    if (slot.value == FlatKeyIndex::EMPTY)
+        return -1; // Cache miss
+
+    if (freqOf(slot.value) < MAX_FREQ)
+        slot.value += 1u << FREQ_SHIFT;
+    return key;
+}
+
+void RingS3FIFOCache::put(int key, int /*value*/)
+{
+    if (capacity == 0)
+    {
+        evicted(key);
+        return;
+    }
+
+    FlatKeyIndex::Slot &slot = index[index.find(key)];
+    if (slot.value != FlatKeyIndex::EMPTY) // Key exists, count the access
+    {
+        if (freqOf(slot.value) < MAX_FREQ)
+            slot.value += 1u << FREQ_SHIFT;
+        return;
+    }
+
+    // Keys remembered by the ghost table skip the small FIFO
+    if (!main_fifo.keys.empty() && ghostTake(key))
+        insertMain(key);
+    else
+        insertSmall(key);
+}
+
+void RingS3FIFOCache::insertSmall(int key)
+{
+    while (small_fifo.full())
+        evictFromSmallFIFO();
+
+    // Evictions move other keys around the index, so look the slot up afterwards
+    uint32_t pos = small_fifo.push(key);
+    index[index.find(key)] = FlatKeyIndex::Slot{key, pos};
+    count++;
+}
+
+void RingS3FIFOCache::insertMain(int key)
+{
+    while (main_fifo.full())
+        evictFromMainFIFO();
+
+    uint32_t pos = main_fifo.push(key);
+    index[index.find(key)] = FlatKeyIndex::Slot{key, MAIN_BIT | pos};
+    count++;
+}
+
+void RingS3FIFOCache::evictFromSmallFIFO()
+{
+    int evict_key = small_fifo.pop();
+    if (evict_key == TOMBSTONE)
+        return;
+
+    size_t slot = index.find(evict_key);
+    if (main_fifo.keys.empty() || freqOf(index[slot].value) < promote_freq)
+    {
+        index.erase(slot);
+        count--;
+        evicted(evict_key);
+        ghostInsert(evict_key);
+        return;
+    }
+
+    // Accessed while in the small FIFO: move to main with a fresh frequency
+    while (main_fifo.full())
+        evictFromMainFIFO();
+    uint32_t pos = main_fifo.push(evict_key);
+    index[index.find(evict_key)].value = MAIN_BIT | pos;
+}
+
+void RingS3FIFOCache::evictFromMainFIFO()
+{
+    while (true)
+    {
+        int evict_key = main_fifo.pop();
+        if (evict_key == TOMBSTONE)
+            return;
+
+        size_t slot = index.find(evict_key);
+        uint32_t freq = freqOf(index[slot].value);
+        if (freq == 0)
+        {
+            index.erase(slot);
+            count--;
+            evicted(evict_key);
+            return;
+        }
+
+        // Second chance: reinsert at the head with one less access
+        uint32_t pos = main_fifo.push(evict_key);
+        index[slot].value = ((freq - 1) << FREQ_SHIFT) | MAIN_BIT | pos;
+    }
+}
+
+void RingS3FIFOCache::ghostInsert(int key)
+{
+    if (ghost_table.empty())
+        return;
+
+    uint64_t h = mixKey(key);
+    uint32_t fingerprint = static_cast<uint32_t>(h >> 32) | 1;
+    GhostEntry *bucket = &ghost_table[(h & ghost_bucket_mask) * GHOST_WAYS];
+    ghost_clock++;
+
+    // Take an unused or expired way, otherwise overwrite the oldest one
+    GhostEntry *victim = bucket;
+    uint32_t victim_age = 0;
+    for (int i = 0; i < GHOST_WAYS; ++i)
+    {
+        uint32_t age = ghost_clock - bucket[i].inserted_at;
+        if (bucket[i].fingerprint == 0 || age >= ghost_size)
+        {
+            victim = &bucket[i];
+            break;
+        }
+        if (age > victim_age)
+        {
+            victim = &bucket[i];
+            victim_age = age;
+        }
+    }
+    *victim = GhostEntry{fingerprint, ghost_clock};
+}
+
+bool RingS3FIFOCache::ghostTake(int key)
+{
+    if (ghost_table.empty())
+        return false;
+
+    uint64_t h = mixKey(key);
+    uint32_t fingerprint = static_cast<uint32_t>(h >> 32) | 1;
+    GhostEntry *bucket = &ghost_table[(h & ghost_bucket_mask) * GHOST_WAYS];
+    for (int i = 0; i < GHOST_WAYS; ++i)
+    {
+        if (bucket[i].fingerprint == fingerprint && ghost_clock - bucket[i].inserted_at < ghost_size)
+        {
+            bucket[i].fingerprint = 0;
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t RingS3FIFOCache::size()
+{
+    return count;
+}
+
+std::set<int> RingS3FIFOCache::getKeys()
+{
+    std::set<int> keys;
+    for (const Ring *ring : {&small_fifo, &main_fifo})
+    {
+        size_t pos = ring->tail;
+        for (size_t i = 0; i < ring->count; ++i)
+        {
+            if (ring->keys[pos] != TOMBSTONE)
+                keys.insert(ring->keys[pos]);
+            if (++pos == ring->keys.size())
+                pos = 0;
+        }
+    }
+    return keys;
+}
+
+bool RingS3FIFOCache::contains(int key)
+{
+    return index[index.find(key)].value != FlatKeyIndex::EMPTY;
+}
+
+void RingS3FIFOCache::remove(int key)
+{
+    size_t slot = index.find(key);
+    uint32_t payload = index[slot].value;
+    if (payload == FlatKeyIndex::EMPTY)
+        return;
+
+    // The ring slot is reclaimed when it reaches the tail
+    Ring &ring = (payload & MAIN_BIT) ? main_fifo : small_fifo;
+    ring.keys[payload & POS_MASK] = TOMBSTONE;
+    index.erase(slot);
+    count--;
+    evicted(key);
+}
@@ -0,0 +1,82 @@
+#ifndef RING_S3_FIFO_CACHE_HPP
+#define RING_S3_FIFO_CACHE_HPP
+
+#include "CacheBase.hpp"
+#include "FlatKeyIndex.hpp"
+#include <cstdint>
+#include <vector>
+#include <set>
+
+// S3-FIFO over two fixed-capacity ring buffers (small and main FIFO) plus a
+// ghost table of key fingerprints. The small FIFO gets fifo_ratio of the
+// capacity and the main FIFO the rest, so the cache never holds more than
+// capacity keys. A 2-bit saturating access frequency is packed next to each
+// key's ring position in the FlatKeyIndex payload, so a hit touches one slot.
+//
+// Keys leaving the small FIFO move to main if they were hit at least
+// (threshold - 1) times, otherwise they are remembered in the ghost table and
+// go straight to main if they come back. Main evicts FIFO order, reinserting
+// keys with a non-zero frequency after decrementing it.
+//
+// Key-only: get() returns the key on a hit. Not internally synchronized.
+class RingS3FIFOCache final : public CacheBase
+{
+private:
+    // FlatKeyIndex payload layout: ring position | main-queue bit | 2-bit frequency
+    static constexpr uint32_t POS_MASK = (1u << 29) - 1;
+    static constexpr uint32_t MAIN_BIT = 1u << 29;
+    static constexpr int FREQ_SHIFT = 30;
+    static constexpr uint32_t MAX_FREQ = 3;
+    static constexpr int TOMBSTONE = INT32_MIN;
+    static constexpr int GHOST_WAYS = 8;
+
+    struct Ring
+    {
+        std::vector<int> keys;
+        size_t head = 0; // next write position
+        size_t tail = 0; // oldest entry
+        size_t count = 0;
+
+        bool full() const { return count == keys.size(); }
+        uint32_t push(int key);
+        int pop();
+    };
+
+    struct GhostEntry
+    {
+        uint32_t fingerprint; // 0 when unused
+        uint32_t inserted_at;
+    };
+
+    size_t capacity;
+    size_t count = 0;
+    uint32_t promote_freq;
+    Ring small_fifo, main_fifo;
+    FlatKeyIndex index;
+
+    std::vector<GhostEntry> ghost_table;
+    size_t ghost_bucket_mask = 0;
+    uint32_t ghost_size;
+    uint32_t ghost_clock = 0;
+
+    static uint32_t freqOf(uint32_t payload) { return payload >> FREQ_SHIFT; }
+
+    void insertSmall(int key);
+    void insertMain(int key);
+    void evictFromSmallFIFO();
+    void evictFromMainFIFO();
+    void ghostInsert(int key);
+    bool ghostTake(int key);
+
+public:
+    RingS3FIFOCache(size_t cap, double fifo_ratio = 0.1, double ghost_ratio = 0.9, int threshold = 2);
+    int get(int key) override;
+    void put(int key, int value) override;
+    size_t size() override;
+    std::set<int> getKeys() override;
+    bool contains(int key) override;
+    void remove(int key) override;
+    void prefetch(int key) const override { index.prefetch(key); }
+};
+
+#endif // RING_S3_FIFO_CACHE_HPP
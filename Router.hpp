@@ -0,0 +1,138 @@
+#ifndef ROUTER_HPP
+#define ROUTER_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Picks the primary replica of each request. Sticky follows the replica
+// column of traces that have one ("key replica op" client files) and is
+// uniform random otherwise; Random always is; Hash sends every request for a
+// key to the same replica; TwoChoices draws two replicas and takes the one
+// this router has sent fewer requests to (Mitzenmacher's power of two
+// choices).
+//
+// Random draws come from xoshiro256** (Blackman and Vigna). Each router is
+// seeded from the configured seed and jumped 2^128 draws per stream, so the
+// workers of one manager get disjoint sequences and a run is reproducible
+// from its seed.
+class Router
+{
+public:
+    enum class Kind
+    {
+        Sticky,
+        Random,
+        Hash,
+        TwoChoices,
+    };
+
+    // The routing config value; ConfigManager has checked it
+    static Kind parseKind(const std::string &name)
+    {
+        if (name == "random")
+            return Kind::Random;
+        if (name == "hash")
+            return Kind::Hash;
+        if (name == "two_choices")
+            return Kind::TwoChoices;
+        return Kind::Sticky;
+    }
+
+    Router() = default;
+
+    Router(Kind kind, int num_replicas, uint64_t seed, unsigned stream)
+        : kind(kind), num_replicas(static_cast<uint32_t>(num_replicas)), load(num_replicas, 0)
+    {
+        for (uint64_t &word : s)
+        {
+            seed += 0x9E3779B97F4A7C15ull;
+            word = mix(seed);
+        }
+        for (unsigned i = 0; i < stream; ++i)
+            jump();
+    }
+
+    // trace_replica is the 1-based replica column of the request, -1 if
+    // the trace has none
+    int route(int key, int trace_replica)
+    {
+        switch (kind)
+        {
+        case Kind::Sticky:
+            if (trace_replica != -1)
+                return trace_replica - 1;
+            return pick(static_cast<uint32_t>(next() >> 32));
+        case Kind::Random:
+            return pick(static_cast<uint32_t>(next() >> 32));
+        case Kind::Hash:
+            return pick(static_cast<uint32_t>(mix(static_cast<uint32_t>(key)) >> 32));
+        case Kind::TwoChoices:
+        {
+            uint64_t draw = next();
+            int first = pick(static_cast<uint32_t>(draw >> 32));
+            int second = pick(static_cast<uint32_t>(draw));
+            int replica = load[second] < load[first] ? second : first;
+            load[replica]++;
+            return replica;
+        }
+        }
+        return 0;
+    }
+
+private:
+    Kind kind = Kind::Sticky;
+    uint32_t num_replicas = 1;
+    uint64_t s[4] = {};
+    // TwoChoices: requests sent to each replica
+    std::vector<uint64_t> load;
+
+    // splitmix64 finalizer
+    static uint64_t mix(uint64_t x)
+    {
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+        return x ^ (x >> 31);
+    }
+
+    static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+    uint64_t next()
+    {
+        uint64_t result = rotl(s[1] * 5, 7) * 9;
+        uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+        return result;
+    }
+
+    void jump()
+    {
+        static constexpr uint64_t JUMP[] = {0x180EC6D33CFD0ABAull, 0xD5A61266F0C9392Cull, 0xA9582618E03FC9AAull,
+                                            0x39ABDC4529B1661Cull};
+        uint64_t jumped[4] = {};
+        for (uint64_t word : JUMP)
+        {
+            for (int b = 0; b < 64; ++b)
+            {
+                if (word & (1ull << b))
+                {
+                    for (int i = 0; i < 4; ++i)
+                        jumped[i] ^= s[i];
+                }
+                next();
+            }
+        }
+        for (int i = 0; i < 4; ++i)
+            s[i] = jumped[i];
+    }
+
+    // Maps 32 uniform bits onto [0, num_replicas) by multiply-shift
+    int pick(uint32_t bits) const { return static_cast<int>((static_cast<uint64_t>(bits) * num_replicas) >> 32); }
+};
+
+#endif // ROUTER_HPP
@@ -11,7 +11,6 @@ S3FIFOCache::S3FIFOCache(size_t cap, double fifo_ratio, double ghost_ratio, int
 
 int S3FIFOCache::get(int key)
 {
-    std::lock_guard<std::mutex> lock(cache_mutex);
     auto it = cache_map.find(key);
     if (it == cache_map.end())
         return -1; // Cache miss
@@ -33,7 +32,6 @@ int S3FIFOCache::get(int key)
 
 void S3FIFOCache::put(int key, int value)
 {
-    std::lock_guard<std::mutex> lock(cache_mutex);
     auto it = cache_map.find(key);
 
     if (it != cache_map.end()) // Key exists, update value
@@ -96,6 +94,7 @@ void S3FIFOCache::evictFromSmallFIFO()
 
     cache_map.erase(evict_key);
     access_count.erase(evict_key);
+    evicted(evict_key);
 }
 
 void S3FIFOCache::evictFromMainFIFO()
@@ -108,17 +107,16 @@ void S3FIFOCache::evictFromMainFIFO()
     main_fifo_map.erase(evict_key);
     cache_map.erase(evict_key);
     access_count.erase(evict_key);
+    evicted(evict_key);
 }
 
 size_t S3FIFOCache::size()
 {
-    std::lock_guard<std::mutex> lock(cache_mutex);
     return cache_map.size();
 }
 
 std::set<int> S3FIFOCache::getKeys()
 {
-    std::lock_guard<std::mutex> lock(cache_mutex);
     std::set<int> keys;
     for (const auto &kv : cache_map)
     {
@@ -129,18 +127,17 @@ std::set<int> S3FIFOCache::getKeys()
 
 bool S3FIFOCache::contains(int key)
 {
-    std::lock_guard<std::mutex> lock(cache_mutex);
     return cache_map.find(key) != cache_map.end();
 }
 
 void S3FIFOCache::remove(int key)
 {
-    std::lock_guard<std::mutex> lock(cache_mutex);
     auto it = cache_map.find(key);
     if (it != cache_map.end())
     {
         cache_map.erase(it);
         access_count.erase(key);
+        evicted(key);
 
         // Remove from FIFO lists
         auto sit = small_fifo_map.find(key);
@@ -4,10 +4,9 @@
 #include "CacheBase.hpp"
 #include <unordered_map>
 #include <list>
-#include <mutex>
 #include <set>
 
-class S3FIFOCache : public CacheBase
+class S3FIFOCache final : public CacheBase
 {
 private:
     size_t capacity, fifo_size, ghost_size;
@@ -18,8 +17,6 @@ private:
     std::unordered_map<int, std::list<int>::iterator> small_fifo_map, main_fifo_map, ghost_list_map;
     std::unordered_map<int, int> access_count;
 
-    mutable std::mutex cache_mutex;
-
 public:
     S3FIFOCache(size_t cap, double fifo_ratio = 0.1, double ghost_ratio = 0.9, int threshold = 2);
     int get(int key) override;
@@ -28,6 +25,15 @@ public:
     std::set<int> getKeys() override;
     bool contains(int key) override;
     void remove(int key) override;
+    // Loads the key's cache_map bucket and prefetches the first node chained
+    // to it
+    void prefetch(int key) const override
+    {
+        size_t bucket = cache_map.bucket(key);
+        auto node = cache_map.cbegin(bucket);
+        if (node != cache_map.cend(bucket))
+            __builtin_prefetch(&*node);
+    }
 
 private:
     void evictFromSmallFIFO();
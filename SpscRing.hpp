@@ -0,0 +1,76 @@
+#ifndef SPSC_RING_HPP
+#define SPSC_RING_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// Bounded single-producer/single-consumer queue. push() and pop() spin with
+// yield when the ring is full or empty, which suits handing off large units
+// of work (trace chunks, request batches) between two long-lived threads.
+template <typename T>
+class SpscRing
+{
+private:
+    std::vector<T> slots;
+    size_t mask;
+    alignas(64) std::atomic<size_t> head{0}; // next slot to write
+    alignas(64) std::atomic<size_t> tail{0}; // next slot to read
+
+public:
+    explicit SpscRing(size_t capacity)
+    {
+        size_t size = 1;
+        while (size < capacity)
+            size <<= 1;
+        slots.resize(size);
+        mask = size - 1;
+    }
+
+    bool tryPush(const T &value)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) == slots.size())
+            return false;
+        slots[h & mask] = value;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPop(T &value)
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire))
+            return false;
+        value = slots[t & mask];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // The value tryPop() would return next, or nullptr if the ring is empty.
+    // Consumer side only.
+    const T *peek() const
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire))
+            return nullptr;
+        return &slots[t & mask];
+    }
+
+    void push(const T &value)
+    {
+        while (!tryPush(value))
+            std::this_thread::yield();
+    }
+
+    T pop()
+    {
+        T value;
+        while (!tryPop(value))
+            std::this_thread::yield();
+        return value;
+    }
+};
+
+#endif // SPSC_RING_HPP
@@ -0,0 +1,14 @@
+#include "TraceFormat.hpp"
+#include <iostream>
+
+// One-shot conversion of a text trace (e.g. seq.txt) to the binary format
+// that RequestProcessor maps directly as seq.bin.
+int main(int argc, char **argv)
+{
+    if (argc != 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " <seq.txt> <seq.bin>\n";
+        return 1;
+    }
+    return convertTextTrace(argv[1], argv[2]) ? 0 : 1;
+}
@@ -0,0 +1,326 @@
+#include "TraceFormat.hpp"
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <cerrno>
+#include <charconv>
+#include <climits>
+#include <algorithm>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "Binary traces are read in place and assume a little-endian host");
+
+namespace
+{
+    constexpr size_t COLUMN_WIDTHS[3] = {sizeof(uint16_t), sizeof(uint8_t), sizeof(uint32_t)};
+
+    size_t alignUp(size_t offset)
+    {
+        return (offset + 7) & ~static_cast<size_t>(7);
+    }
+
+    // Fills offsets[0] (keys) and offsets[1..3] (replica, op, size; 0 when
+    // absent) and returns the total file size
+    size_t computeLayout(const TraceHeader &header, size_t offsets[4])
+    {
+        size_t offset = sizeof(TraceHeader);
+        offsets[0] = offset;
+        offset += header.num_requests * header.key_width;
+        for (int c = 0; c < 3; ++c)
+        {
+            offsets[c + 1] = 0;
+            if (header.columns & (1u << c))
+            {
+                offset = alignUp(offset);
+                offsets[c + 1] = offset;
+                offset += header.num_requests * COLUMN_WIDTHS[c];
+            }
+        }
+        return offset;
+    }
+
+    struct TextRequest
+    {
+        uint64_t key = 0;
+        uint64_t replica = 0;
+        uint8_t op = TRACE_OP_GET;
+        uint64_t size = 0;
+        int fields = 0;
+    };
+
+    const char *skipSpaces(const char *p, const char *end)
+    {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == ',' || *p == '\r'))
+            ++p;
+        return p;
+    }
+
+    uint8_t parseOp(const char *p, const char *end)
+    {
+        auto is = [&](const char *name)
+        {
+            size_t len = std::strlen(name);
+            if (static_cast<size_t>(end - p) != len)
+                return false;
+            for (size_t i = 0; i < len; ++i)
+            {
+                if ((p[i] | 0x20) != name[i])
+                    return false;
+            }
+            return true;
+        };
+        if (is("get"))
+            return TRACE_OP_GET;
+        if (is("set"))
+            return TRACE_OP_SET;
+        if (is("delete"))
+            return TRACE_OP_DELETE;
+        return TRACE_OP_OTHER;
+    }
+
+    // Parses "key [replica [op [size]]]"; false if the line has no key
+    bool parseTextLine(const char *p, const char *end, TextRequest &req)
+    {
+        req = TextRequest{};
+        p = skipSpaces(p, end);
+        auto [key_end, ec] = std::from_chars(p, end, req.key);
+        if (ec != std::errc())
+            return false;
+        req.fields = 1;
+
+        p = skipSpaces(key_end, end);
+        auto [replica_end, replica_ec] = std::from_chars(p, end, req.replica);
+        if (replica_ec != std::errc())
+            return true;
+        req.fields = 2;
+
+        p = skipSpaces(replica_end, end);
+        const char *op_end = p;
+        while (op_end < end && *op_end != ' ' && *op_end != '\t' && *op_end != ',' && *op_end != '\r')
+            ++op_end;
+        if (op_end == p)
+            return true;
+        req.op = parseOp(p, op_end);
+        req.fields = 3;
+
+        p = skipSpaces(op_end, end);
+        if (std::from_chars(p, end, req.size).ec == std::errc())
+            req.fields = 4;
+        return true;
+    }
+
+    template <typename F>
+    void forEachLine(const char *data, size_t size, F &&f)
+    {
+        const char *ptr = data;
+        const char *end = data + size;
+        while (ptr < end)
+        {
+            const char *line_end = static_cast<const char *>(memchr(ptr, '\n', end - ptr));
+            if (!line_end)
+                line_end = end;
+            f(ptr, line_end);
+            ptr = line_end + 1;
+        }
+    }
+
+    const void *mapFile(const std::string &path, size_t &size)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd == -1)
+        {
+            std::cerr << "Error: Could not open file " << path << "\n";
+            return nullptr;
+        }
+        struct stat sb;
+        if (fstat(fd, &sb) == -1)
+        {
+            std::cerr << "Error: fstat failed\n";
+            ::close(fd);
+            return nullptr;
+        }
+        size = sb.st_size;
+        if (size == 0)
+        {
+            ::close(fd);
+            std::cerr << "Error: " << path << " is empty\n";
+            return nullptr;
+        }
+        void *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED)
+        {
+            std::cerr << "Error: Memory mapping failed: " << strerror(errno) << "\n";
+            return nullptr;
+        }
+        return data;
+    }
+}
+
+MappedTrace::~MappedTrace()
+{
+    close();
+}
+
+bool MappedTrace::open(const std::string &path)
+{
+    close();
+    size_t size = 0;
+    const void *mapped = mapFile(path, size);
+    if (!mapped)
+        return false;
+
+    data = static_cast<const uint8_t *>(mapped);
+    file_size = size;
+    if (file_size < sizeof(TraceHeader))
+    {
+        std::cerr << "Error: " << path << " is too small to be a binary trace\n";
+        close();
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(TraceHeader));
+    if (std::memcmp(header.magic, TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0 || header.version != TRACE_VERSION ||
+        (header.key_width != 4 && header.key_width != 8))
+    {
+        std::cerr << "Error: " << path << " is not a version " << TRACE_VERSION << " binary trace\n";
+        close();
+        return false;
+    }
+    if (computeLayout(header, column_offsets) > file_size)
+    {
+        std::cerr << "Error: " << path << " is truncated\n";
+        close();
+        return false;
+    }
+
+    madvise(const_cast<uint8_t *>(data), file_size, MADV_SEQUENTIAL);
+    return true;
+}
+
+void MappedTrace::close()
+{
+    if (data)
+    {
+        munmap(const_cast<uint8_t *>(data), file_size);
+        data = nullptr;
+    }
+    file_size = 0;
+    header = TraceHeader{};
+}
+
+uint64_t MappedTrace::keyAt(size_t i) const
+{
+    const uint8_t *column = data + column_offsets[0];
+    if (header.key_width == 4)
+        return reinterpret_cast<const uint32_t *>(column)[i];
+    return reinterpret_cast<const uint64_t *>(column)[i];
+}
+
+const int *MappedTrace::keys() const
+{
+    return header.key_width == 4 ? reinterpret_cast<const int *>(data + column_offsets[0]) : nullptr;
+}
+
+const uint16_t *MappedTrace::replicas() const
+{
+    return column_offsets[1] ? reinterpret_cast<const uint16_t *>(data + column_offsets[1]) : nullptr;
+}
+
+const uint8_t *MappedTrace::ops() const
+{
+    return column_offsets[2] ? data + column_offsets[2] : nullptr;
+}
+
+const uint32_t *MappedTrace::sizes() const
+{
+    return column_offsets[3] ? reinterpret_cast<const uint32_t *>(data + column_offsets[3]) : nullptr;
+}
+
+bool isBinaryTrace(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    char magic[sizeof(TRACE_MAGIC)];
+    return file.read(magic, sizeof(magic)) && std::memcmp(magic, TRACE_MAGIC, sizeof(magic)) == 0;
+}
+
+bool convertTextTrace(const std::string &text_path, const std::string &binary_path)
+{
+    size_t text_size = 0;
+    const char *text = static_cast<const char *>(mapFile(text_path, text_size));
+    if (!text)
+        return false;
+    madvise(const_cast<char *>(text), text_size, MADV_SEQUENTIAL);
+
+    // First pass: count requests and pick the key width and columns
+    TraceHeader header{};
+    std::memcpy(header.magic, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    header.version = TRACE_VERSION;
+    uint64_t max_key = 0;
+    int fields = 0;
+    TextRequest req;
+    forEachLine(text, text_size, [&](const char *line, const char *line_end)
+                {
+        if (!parseTextLine(line, line_end, req))
+            return;
+        if (header.num_requests++ == 0)
+            fields = req.fields;
+        max_key = std::max(max_key, req.key); });
+
+    header.key_width = max_key > INT32_MAX ? 8 : 4;
+    if (fields >= 2)
+        header.columns |= TRACE_COLUMN_REPLICA;
+    if (fields >= 3)
+        header.columns |= TRACE_COLUMN_OP;
+    if (fields >= 4)
+        header.columns |= TRACE_COLUMN_SIZE;
+
+    size_t offsets[4];
+    size_t binary_size = computeLayout(header, offsets);
+
+    int fd = ::open(binary_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1 || ftruncate(fd, binary_size) == -1)
+    {
+        std::cerr << "Error: Could not create " << binary_path << ": " << strerror(errno) << "\n";
+        if (fd != -1)
+            ::close(fd);
+        munmap(const_cast<char *>(text), text_size);
+        return false;
+    }
+    void *mapped = mmap(nullptr, binary_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED)
+    {
+        std::cerr << "Error: Memory mapping failed: " << strerror(errno) << "\n";
+        munmap(const_cast<char *>(text), text_size);
+        return false;
+    }
+    uint8_t *out = static_cast<uint8_t *>(mapped);
+    std::memcpy(out, &header, sizeof(TraceHeader));
+
+    // Second pass: scatter each request into its columns
+    size_t i = 0;
+    forEachLine(text, text_size, [&](const char *line, const char *line_end)
+                {
+        if (!parseTextLine(line, line_end, req))
+            return;
+        if (header.key_width == 4)
+            reinterpret_cast<uint32_t *>(out + offsets[0])[i] = static_cast<uint32_t>(req.key);
+        else
+            reinterpret_cast<uint64_t *>(out + offsets[0])[i] = req.key;
+        if (offsets[1])
+            reinterpret_cast<uint16_t *>(out + offsets[1])[i] = static_cast<uint16_t>(req.replica);
+        if (offsets[2])
+            out[offsets[2] + i] = req.op;
+        if (offsets[3])
+            reinterpret_cast<uint32_t *>(out + offsets[3])[i] = static_cast<uint32_t>(req.size);
+        i++; });
+
+    munmap(mapped, binary_size);
+    munmap(const_cast<char *>(text), text_size);
+    std::cout << "Converted " << header.num_requests << " requests from " << text_path << " to " << binary_path
+              << " (" << header.key_width << "-byte keys)\n";
+    return true;
+}
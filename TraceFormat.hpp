@@ -0,0 +1,84 @@
+#ifndef TRACE_FORMAT_HPP
+#define TRACE_FORMAT_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+// Binary trace layout (little-endian):
+//   TraceHeader, 64 bytes
+//   key column:     num_requests keys of key_width bytes
+//   replica column: num_requests uint16_t, if TRACE_COLUMN_REPLICA is set
+//   op column:      num_requests uint8_t (TraceOp), if TRACE_COLUMN_OP is set
+//   size column:    num_requests uint32_t, if TRACE_COLUMN_SIZE is set
+// Every column starts at an 8-byte aligned offset.
+
+constexpr char TRACE_MAGIC[8] = {'L', 'D', 'C', 'T', 'R', 'A', 'C', 'E'};
+constexpr uint32_t TRACE_VERSION = 1;
+
+enum TraceColumn : uint32_t
+{
+    TRACE_COLUMN_REPLICA = 1u << 0,
+    TRACE_COLUMN_OP = 1u << 1,
+    TRACE_COLUMN_SIZE = 1u << 2,
+};
+
+enum TraceOp : uint8_t
+{
+    TRACE_OP_GET = 0,
+    TRACE_OP_SET = 1,
+    TRACE_OP_DELETE = 2,
+    TRACE_OP_OTHER = 3,
+};
+
+struct TraceHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t key_width; // 4 or 8
+    uint64_t num_requests;
+    uint32_t columns; // TraceColumn bits
+    uint32_t reserved[9];
+};
+static_assert(sizeof(TraceHeader) == 64, "TraceHeader must stay 64 bytes");
+
+// Read-only mmap of a binary trace; the columns point straight into the
+// mapping, so nothing is parsed or copied.
+class MappedTrace
+{
+private:
+    const uint8_t *data = nullptr;
+    size_t file_size = 0;
+    TraceHeader header{};
+    size_t column_offsets[4] = {0, 0, 0, 0};
+
+public:
+    MappedTrace() = default;
+    ~MappedTrace();
+    MappedTrace(const MappedTrace &) = delete;
+    MappedTrace &operator=(const MappedTrace &) = delete;
+
+    // Prints the reason to stderr and returns false if path is not a valid trace
+    bool open(const std::string &path);
+    void close();
+
+    size_t size() const { return header.num_requests; }
+    uint32_t keyWidth() const { return header.key_width; }
+    uint64_t keyAt(size_t i) const;
+    // Key column as ints; only valid for 4-byte keys
+    const int *keys() const;
+    // Optional columns, nullptr when the trace does not have them
+    const uint16_t *replicas() const;
+    const uint8_t *ops() const;
+    const uint32_t *sizes() const;
+};
+
+// True if the file at path starts with TRACE_MAGIC
+bool isBinaryTrace(const std::string &path);
+
+// Converts a text trace (one request per line: key [replica [op [size]]]) to
+// the binary format. The columns present on the first line are kept, and keys
+// are stored in 4 bytes unless one exceeds INT32_MAX.
+bool convertTextTrace(const std::string &text_path, const std::string &binary_path);
+
+#endif // TRACE_FORMAT_HPP
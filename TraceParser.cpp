@@ -0,0 +1,129 @@
+#include "TraceParser.hpp"
+#include <algorithm>
+#include <functional>
+#include <thread>
+
+namespace
+{
+    // Ranges smaller than this are not worth a thread
+    constexpr size_t MIN_RANGE_BYTES = 1 << 20;
+
+    struct RangeOutput
+    {
+        std::vector<int> keys;
+        std::vector<int> replicas;
+        size_t invalid_lines = 0;
+    };
+
+    const char *skipBlanks(const char *p, const char *end)
+    {
+        while (p < end && (*p == ' ' || *p == '\t'))
+            ++p;
+        return p;
+    }
+
+    void parseRange(const char *p, const char *end, bool with_replicas, RangeOutput &out)
+    {
+        // Most trace lines are well under 16 bytes per key column
+        out.keys.reserve((end - p) / 16);
+        if (with_replicas)
+            out.replicas.reserve((end - p) / 16);
+
+        while (p < end)
+        {
+            const char *line_end = static_cast<const char *>(memchr(p, '\n', end - p));
+            if (!line_end)
+                line_end = end;
+
+            uint64_t key, replica;
+            const char *field = skipBlanks(p, line_end);
+            const char *key_end = parseDecimal(field, line_end, key);
+            if (key_end == field)
+            {
+                if (with_replicas)
+                    out.invalid_lines++;
+            }
+            else if (!with_replicas)
+            {
+                out.keys.push_back(static_cast<int>(key));
+            }
+            else
+            {
+                field = skipBlanks(key_end, line_end);
+                const char *replica_end = parseDecimal(field, line_end, replica);
+                const char *op = skipBlanks(replica_end, line_end);
+                // The op column is required but not used
+                if (replica_end == field || replica_end == op || op == line_end || *op == '\r')
+                {
+                    out.invalid_lines++;
+                }
+                else
+                {
+                    out.keys.push_back(static_cast<int>(key));
+                    out.replicas.push_back(static_cast<int>(replica));
+                }
+            }
+            p = line_end + 1;
+        }
+    }
+}
+
+ParsedTrace parseTextTrace(const char *data, size_t size, unsigned num_threads, bool with_replicas)
+{
+    size_t num_ranges = std::max<size_t>(1, std::min<size_t>(num_threads, size / MIN_RANGE_BYTES));
+
+    // Split at newline boundaries so every line belongs to exactly one range
+    std::vector<const char *> bounds(num_ranges + 1);
+    bounds[0] = data;
+    bounds[num_ranges] = data + size;
+    for (size_t r = 1; r < num_ranges; ++r)
+    {
+        const char *split = std::max(data + size * r / num_ranges, bounds[r - 1]);
+        const char *newline = static_cast<const char *>(memchr(split, '\n', data + size - split));
+        bounds[r] = newline ? newline + 1 : data + size;
+    }
+
+    std::vector<RangeOutput> outputs(num_ranges);
+    std::vector<std::thread> threads;
+    for (size_t r = 1; r < num_ranges; ++r)
+        threads.emplace_back(parseRange, bounds[r], bounds[r + 1], with_replicas, std::ref(outputs[r]));
+    parseRange(bounds[0], bounds[1], with_replicas, outputs[0]);
+    for (auto &t : threads)
+        t.join();
+
+    ParsedTrace parsed;
+    if (num_ranges == 1)
+    {
+        parsed.keys = std::move(outputs[0].keys);
+        parsed.replicas = std::move(outputs[0].replicas);
+        parsed.invalid_lines = outputs[0].invalid_lines;
+        return parsed;
+    }
+
+    // Stitch the ranges together in file order, one copy thread per range
+    std::vector<size_t> offsets(num_ranges + 1, 0);
+    for (size_t r = 0; r < num_ranges; ++r)
+    {
+        offsets[r + 1] = offsets[r] + outputs[r].keys.size();
+        parsed.invalid_lines += outputs[r].invalid_lines;
+    }
+    parsed.keys.resize(offsets[num_ranges]);
+    if (with_replicas)
+        parsed.replicas.resize(offsets[num_ranges]);
+
+    auto copyRange = [&](size_t r)
+    {
+        std::copy(outputs[r].keys.begin(), outputs[r].keys.end(), parsed.keys.begin() + offsets[r]);
+        if (with_replicas)
+            std::copy(outputs[r].replicas.begin(), outputs[r].replicas.end(), parsed.replicas.begin() + offsets[r]);
+        std::vector<int>().swap(outputs[r].keys);
+        std::vector<int>().swap(outputs[r].replicas);
+    };
+    threads.clear();
+    for (size_t r = 1; r < num_ranges; ++r)
+        threads.emplace_back(copyRange, r);
+    copyRange(0);
+    for (auto &t : threads)
+        t.join();
+    return parsed;
+}
@@ -0,0 +1,60 @@
+#ifndef TRACE_PARSER_HPP
+#define TRACE_PARSER_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+// Parses the unsigned decimal at p, eight digits per step: each 8-byte load is
+// checked for digits and folded into its value with three multiplies (SWAR).
+// Returns the first byte after the number, or p itself if it has no digits.
+inline const char *parseDecimal(const char *p, const char *end, uint64_t &value)
+{
+    constexpr uint64_t ZEROS = 0x3030303030303030ULL;
+    constexpr uint64_t HIGH_NIBBLES = 0xF0F0F0F0F0F0F0F0ULL;
+    constexpr uint64_t SIX = 0x0606060606060606ULL;
+
+    value = 0;
+    while (end - p >= 8)
+    {
+        uint64_t word;
+        std::memcpy(&word, p, sizeof(word));
+        // Non-zero bytes mark non-digits: outside 0x30..0x3F, or above '9'
+        uint64_t non_digits = ((word & HIGH_NIBBLES) ^ ZEROS) | (((word + SIX) & HIGH_NIBBLES) ^ ZEROS);
+        int digits = non_digits ? __builtin_ctzll(non_digits) / 8 : 8;
+        if (digits == 0)
+            return p;
+
+        // Keep the leading digits in the high bytes, zeros in front
+        uint64_t v = (word - ZEROS) << (8 * (8 - digits));
+        v = (v * 2561) >> 8;
+        v = ((v & 0x00FF00FF00FF00FFULL) * 6553601) >> 16;
+        v = ((v & 0x0000FFFF0000FFFFULL) * 42949672960001ULL) >> 32;
+
+        static constexpr uint64_t POW10[9] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000};
+        value = value * POW10[digits] + v;
+        p += digits;
+        if (digits < 8)
+            return p;
+    }
+    while (p < end && static_cast<unsigned char>(*p - '0') < 10)
+        value = value * 10 + (*p++ - '0');
+    return p;
+}
+
+struct ParsedTrace
+{
+    std::vector<int> keys;
+    std::vector<int> replicas; // only filled when replica columns are requested
+    size_t invalid_lines = 0;
+};
+
+// Parses a text trace (one request per line) on num_threads threads. The data
+// is split at newline boundaries, each thread parses its range into its own
+// buffers, and the ranges are stitched back together in file order. With
+// with_replicas, lines must be "key replica op"; otherwise only the leading key
+// is read and lines without one are skipped.
+ParsedTrace parseTextTrace(const char *data, size_t size, unsigned num_threads, bool with_replicas);
+
+#endif // TRACE_PARSER_HPP
@@ -0,0 +1,167 @@
+#include "TraceStream.hpp"
+#include "TraceParser.hpp"
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// The read buffer (two read blocks) takes up to a quarter of the budget; the
+// rest is split into at least two chunks so the reader can fill one while the
+// other is simulated
+size_t TraceStream::readBlockSize(size_t memory_budget_bytes)
+{
+    return std::clamp<size_t>(memory_budget_bytes / 8, 64 << 10, MAX_READ_BLOCK_SIZE);
+}
+
+size_t TraceStream::chunkRequests(size_t memory_budget_bytes)
+{
+    size_t chunk_budget = memory_budget_bytes - std::min(memory_budget_bytes, 2 * readBlockSize(memory_budget_bytes));
+    return std::clamp<size_t>(chunk_budget / (4 * sizeof(int)), 1024, MAX_CHUNK_REQUESTS);
+}
+
+size_t TraceStream::chunkCount(size_t memory_budget_bytes)
+{
+    size_t chunk_budget = memory_budget_bytes - std::min(memory_budget_bytes, 2 * readBlockSize(memory_budget_bytes));
+    return std::max<size_t>(2, chunk_budget / (chunkRequests(memory_budget_bytes) * sizeof(int)));
+}
+
+TraceStream::TraceStream(const std::string &file_path, size_t memory_budget_bytes)
+    : path(file_path), read_block_size(readBlockSize(memory_budget_bytes)), chunks(chunkCount(memory_budget_bytes)),
+      filled_chunks(chunkCount(memory_budget_bytes) + 1), free_chunks(chunkCount(memory_budget_bytes))
+{
+    fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+    {
+        std::cerr << "Error: Could not open file " << path << "\n";
+        finished = true;
+        return;
+    }
+    struct stat sb;
+    if (fstat(fd, &sb) == 0)
+    {
+        file_size = sb.st_size;
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    size_t chunk_requests = chunkRequests(memory_budget_bytes);
+    for (size_t i = 0; i < chunks.size(); ++i)
+    {
+        chunks[i].keys.resize(chunk_requests);
+        free_chunks.push(i);
+    }
+    std::cout << "Streaming " << path << " through " << chunks.size() << " chunks of " << chunk_requests << " requests\n";
+    reader = std::thread(&TraceStream::readTrace, this);
+}
+
+TraceStream::~TraceStream()
+{
+    stopping = true;
+    if (reader.joinable())
+    {
+        reader.join();
+    }
+    if (fd != -1)
+    {
+        close(fd);
+    }
+}
+
+bool TraceStream::acquireChunk(size_t &chunk)
+{
+    while (!free_chunks.tryPop(chunk))
+    {
+        if (stopping)
+            return false;
+        std::this_thread::yield();
+    }
+    chunks[chunk].count = 0;
+    return true;
+}
+
+void TraceStream::readTrace()
+{
+    std::vector<char> buffer(2 * read_block_size);
+    size_t carry = 0;
+    uint64_t parsed_offset = 0;
+    size_t chunk;
+    if (!acquireChunk(chunk))
+        return;
+
+    auto parseLine = [&](const char *line, const char *line_end)
+    {
+        while (line < line_end && (*line == ' ' || *line == '\t'))
+            ++line;
+        uint64_t key;
+        if (parseDecimal(line, line_end, key) == line)
+            return true;
+
+        TraceChunk &c = chunks[chunk];
+        c.keys[c.count++] = static_cast<int>(key);
+        if (c.count < c.keys.size())
+            return true;
+        filled_chunks.push(chunk);
+        return acquireChunk(chunk);
+    };
+
+    while (!stopping)
+    {
+        ssize_t n = read(fd, buffer.data() + carry, read_block_size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+        {
+            std::cerr << "Error: Reading " << path << " failed: " << strerror(errno) << "\n";
+            break;
+        }
+        if (n == 0)
+            break;
+        bytes_read += n;
+
+        const char *ptr = buffer.data();
+        const char *end = ptr + carry + n;
+        while (const char *newline = static_cast<const char *>(memchr(ptr, '\n', end - ptr)))
+        {
+            if (!parseLine(ptr, newline))
+                return;
+            ptr = newline + 1;
+        }
+        carry = end - ptr;
+        if (carry > read_block_size)
+        {
+            std::cerr << "Warning: Skipping oversized line in " << path << "\n";
+            carry = 0;
+        }
+        memmove(buffer.data(), ptr, carry);
+
+        // Parsed bytes are never read again, so keep them out of the page cache
+        uint64_t consumed = bytes_read - carry;
+        posix_fadvise(fd, parsed_offset, consumed - parsed_offset, POSIX_FADV_DONTNEED);
+        parsed_offset = consumed;
+    }
+
+    if (carry > 0 && !parseLine(buffer.data(), buffer.data() + carry))
+        return;
+    if (chunks[chunk].count > 0)
+        filled_chunks.push(chunk);
+    filled_chunks.push(END_OF_TRACE);
+}
+
+const TraceChunk *TraceStream::next()
+{
+    if (finished)
+        return nullptr;
+    if (current != END_OF_TRACE)
+    {
+        free_chunks.push(current);
+    }
+    current = filled_chunks.pop();
+    if (current == END_OF_TRACE)
+    {
+        finished = true;
+        return nullptr;
+    }
+    return &chunks[current];
+}
@@ -0,0 +1,60 @@
+#ifndef TRACE_STREAM_HPP
+#define TRACE_STREAM_HPP
+
+#include "SpscRing.hpp"
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct TraceChunk
+{
+    std::vector<int> keys;
+    size_t count = 0;
+};
+
+// Streams the keys of a text trace (one request per line, key first) through
+// a fixed pool of chunks. A reader thread parses ahead into free chunks while
+// the caller simulates filled ones, so parsing overlaps simulation and memory
+// stays within the budget no matter how long the trace is.
+class TraceStream
+{
+private:
+    static constexpr size_t END_OF_TRACE = SIZE_MAX;
+    static constexpr size_t MAX_READ_BLOCK_SIZE = 4 << 20;
+    static constexpr size_t MAX_CHUNK_REQUESTS = 1 << 20;
+
+    std::string path;
+    int fd = -1;
+    size_t read_block_size;
+    std::vector<TraceChunk> chunks;
+    SpscRing<size_t> filled_chunks;
+    SpscRing<size_t> free_chunks;
+    size_t current = END_OF_TRACE;
+    bool finished = false;
+    std::atomic<bool> stopping{false};
+    std::atomic<uint64_t> bytes_read{0};
+    uint64_t file_size = 0;
+    std::thread reader;
+
+    static size_t readBlockSize(size_t memory_budget_bytes);
+    static size_t chunkRequests(size_t memory_budget_bytes);
+    static size_t chunkCount(size_t memory_budget_bytes);
+    bool acquireChunk(size_t &chunk);
+    void readTrace();
+
+public:
+    TraceStream(const std::string &file_path, size_t memory_budget_bytes);
+    ~TraceStream();
+    TraceStream(const TraceStream &) = delete;
+    TraceStream &operator=(const TraceStream &) = delete;
+
+    // Next chunk of keys, or nullptr once the trace is exhausted. The chunk
+    // returned by the previous call goes back to the reader.
+    const TraceChunk *next();
+    uint64_t fileSize() const { return file_size; }
+    uint64_t bytesRead() const { return bytes_read.load(std::memory_order_relaxed); }
+};
+
+#endif // TRACE_STREAM_HPP
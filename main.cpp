@@ -1,5 +1,6 @@
 #include "ReplicaManager.hpp"
 #include "RequestProcessor.hpp"
+#include "MissRatioCurve.hpp"
 #include <iostream>
 #include <thread>
 #include <atomic>
@@ -9,48 +10,211 @@
 
 namespace fs = std::filesystem;
 
-std::atomic<int> completed_requests(0);
+std::atomic<uint64_t> completed_requests(0);
 
-int main()
+// "workload/<workload>/<workload_number>/workload_<workload>_<workload_number>",
+// creating the directory
+std::string resultsPrefix(ConfigManager &config)
 {
-    ConfigManager config("config.json");
-
-    completed_requests = 0;
-
-    // config.printConfig();
-
-    ReplicaManager manager(config);
-
-    std::string folder_path = config.workload_folder; // Folder containing request files
-    RequestProcessor requestProcessor(folder_path);
-
-    // requestProcessor.processAllFilesParallel(manager);
-    requestProcessor.processFirstFile(manager);
-
-    int cache_percent = static_cast<int>(config.cache_percentage * 100);
-    std::string is_rdma = config.rdma_enabled ? "rdma" : "no_rdma";
-    std::string is_cba = config.enable_cba ? "cba" : "no_cba";
-    std::string is_dedup = config.enable_de_duplication ? "dedup" : "no_dedup";
-    std::string is_fixed_access_rate = config.is_access_rate_fixed ? "fixed" : "variable";
+    std::string folder_path = config.workload_folder;
 
     // Extract workload and workload number from folder path
     size_t last_slash = folder_path.find_last_of("/");
     size_t second_last_slash = folder_path.find_last_of("/", last_slash - 1);
     std::string workload = (second_last_slash != std::string::npos) ? folder_path.substr(second_last_slash + 1, last_slash - second_last_slash - 1) : "unknown";
     std::string workload_number = (last_slash != std::string::npos) ? folder_path.substr(last_slash + 1) : "unknown";
-    std::string cache_policy = config.cache_type;
 
     // Construct directory path: "workload/<workload>/<workload_number>/"
     std::string output_folder = "workload/" + workload + "/" + workload_number;
     fs::create_directories(output_folder);
 
+    return output_folder + "/workload_" + workload + "_" + workload_number;
+}
+
+// Results file of a run, "<prefix>_cache_<policy>_<pct>_..." ending in suffix
+std::string resultsFilename(ConfigManager &config, const std::string &suffix = ".txt")
+{
+    int cache_percent = static_cast<int>(config.cache_percentage * 100);
+    std::string is_rdma = config.rdma_enabled ? "rdma" : "no_rdma";
+    std::string is_cba = config.enable_cba ? "cba" : "no_cba";
+    std::string is_dedup = config.enable_de_duplication ? "dedup" : "no_dedup";
+    std::string is_fixed_access_rate = config.is_access_rate_fixed ? "fixed" : "variable";
+    std::string cache_policy = config.cache_type;
+
     // Construct filename
-    std::string filename = output_folder + "/workload_" + workload + "_" + workload_number + "_cache_" + cache_policy + "_" +
-                           std::to_string(cache_percent) + "_" + is_rdma + "_" + is_cba + "_access_rate" +
-                           is_fixed_access_rate + "_" + is_dedup + ".txt";
+    return resultsPrefix(config) + "_cache_" + cache_policy + "_" +
+           std::to_string(cache_percent) + "_" + is_rdma + "_" + is_cba + "_access_rate" +
+           is_fixed_access_rate + "_" + is_dedup + config.result_suffix + suffix;
+}
+
+template <typename Policy>
+void writeResults(ReplicaManager<Policy> &manager, ConfigManager &config)
+{
+    std::string filename = resultsFilename(config);
     manager.computeAndWriteMetrics(filename, config.cache_percentage, config.total_dataset_size);
 
     std::cout << "Simulation complete. Stats written to " << filename << "\n";
+}
+
+template <typename Policy>
+void runSimulation(ConfigManager &config)
+{
+    ReplicaManager<Policy> manager(config);
+    manager.writeWindowsTo(resultsFilename(config, "_windows.csv"));
+
+    std::string folder_path = config.workload_folder; // Folder containing request files
+    RequestProcessor requestProcessor(folder_path, config.stream_memory_budget_mb << 20);
+
+    if (config.num_threads > 1)
+        requestProcessor.processAllFilesParallel(manager);
+    else
+        requestProcessor.processFirstFile(manager);
+
+    if (completed_requests == 0)
+    {
+        std::cerr << "Error: No requests replayed from " << folder_path << "; no results written\n";
+        return;
+    }
+    writeResults(manager, config);
+}
+
+// Loads the trace once and replays it into one ReplicaManager per sweep
+// configuration, running sweep_threads (default: one per core) at a time
+void runSweep(ConfigManager &config, std::vector<ConfigManager> &sweep)
+{
+    RequestProcessor requestProcessor(config.workload_folder);
+    LoadedTrace trace;
+    if (!requestProcessor.loadFirstFile(trace))
+    {
+        std::cerr << "Error: No trace to sweep in " << config.workload_folder << "\n";
+        return;
+    }
+
+    unsigned threads = config.sweep_threads ? config.sweep_threads : std::max(1u, std::thread::hardware_concurrency());
+    size_t num_workers = std::min<size_t>(sweep.size(), threads);
+    std::cout << "Sweeping " << sweep.size() << " configurations over " << trace.size() << " requests on "
+              << num_workers << " threads\n";
+    std::thread progress_thread(displayProgressBar, static_cast<uint64_t>(trace.size()) * sweep.size());
+
+    std::atomic<size_t> next_config(0);
+    std::vector<std::thread> workers;
+    for (size_t w = 0; w < num_workers; ++w)
+    {
+        workers.emplace_back([&]()
+                             {
+            for (size_t i = next_config++; i < sweep.size(); i = next_config++)
+            {
+                dispatchCachePolicy(sweep[i].cache_type, [&](auto policy)
+                                    {
+                    ReplicaManager<decltype(policy)> manager(sweep[i]);
+                    manager.writeWindowsTo(resultsFilename(sweep[i], "_windows.csv"));
+                    RequestProcessor::replayShared(manager, trace);
+                    writeResults(manager, sweep[i]); });
+            } });
+    }
+    for (auto &worker : workers)
+        worker.join();
+    progress_thread.join();
+}
+
+// Splits the keys of the first trace into key_shards slices by hash and
+// simulates each slice on its own thread with its share of the dataset and
+// capacity, then writes the merged counters as a single run
+template <typename Policy>
+void runSharded(ConfigManager &config)
+{
+    RequestProcessor requestProcessor(config.workload_folder);
+    LoadedTrace trace;
+    if (!requestProcessor.loadFirstFile(trace))
+    {
+        std::cerr << "Error: No trace to shard in " << config.workload_folder << "\n";
+        return;
+    }
+
+    std::vector<ConfigManager> shard_configs = config.shardConfigs();
+    std::vector<std::unique_ptr<ReplicaManager<Policy>>> shards;
+    for (ConfigManager &shard_config : shard_configs)
+        shards.push_back(std::make_unique<ReplicaManager<Policy>>(shard_config));
+
+    std::cout << "Simulating " << shards.size() << " key shards of " << trace.size() << " requests\n";
+    // Every shard reads the whole trace and keeps its own keys
+    std::thread progress_thread(displayProgressBar, static_cast<uint64_t>(trace.size()) * shards.size());
+    std::vector<std::thread> workers;
+    for (auto &shard : shards)
+    {
+        workers.emplace_back([&trace, &shard]()
+                             { RequestProcessor::replayShared(*shard, trace); });
+    }
+    for (auto &worker : workers)
+        worker.join();
+    progress_thread.join();
+
+    for (size_t i = 1; i < shards.size(); ++i)
+        shards[0]->mergeShard(*shards[i]);
+    config.result_suffix += "_key_shards-" + std::to_string(config.key_shards);
+    writeResults(*shards[0], config);
+}
+
+// Computes the LRU miss-ratio curves of the first trace in one pass instead
+// of one simulation per cache_percentage
+void runMissRatioCurve(ConfigManager &config)
+{
+    RequestProcessor requestProcessor(config.workload_folder);
+    LoadedTrace trace;
+    if (!requestProcessor.loadFirstFile(trace))
+    {
+        std::cerr << "Error: No trace to analyze in " << config.workload_folder << "\n";
+        return;
+    }
+
+    Router router(Router::parseKind(config.routing), config.num_replicas, config.routing_seed, 0);
+    MissRatioCurve curve(config.num_replicas, config.total_dataset_size, config.mrc_points, config.rdma_enabled, router);
+    std::thread progress_thread(displayProgressBar, static_cast<uint64_t>(trace.size()));
+    const size_t batch = 1 << 16;
+    for (size_t i = 0; i < trace.size(); i += batch)
+    {
+        size_t count = std::min(batch, trace.size() - i);
+        curve.record(trace.keys() + i, count);
+        completed_requests += count;
+    }
+    progress_thread.join();
+
+    std::string is_rdma = config.rdma_enabled ? "rdma" : "no_rdma";
+    std::string filename = resultsPrefix(config) + "_cache_" + config.cache_type + "_mrc_" + is_rdma + ".csv";
+    if (curve.writeToFile(filename, config.latency_local, config.latency_rdma, config.latency_disk))
+        std::cout << "Miss-ratio curve written to " << filename << "\n";
+}
+
+int main()
+{
+    ConfigManager config(std::string("config.json"));
+
+    completed_requests = 0;
+
+    // config.printConfig();
+
+    if (config.miss_ratio_curve)
+    {
+        runMissRatioCurve(config);
+        return 0;
+    }
+
+    std::vector<ConfigManager> sweep = config.sweepConfigs();
+    if (!sweep.empty())
+    {
+        runSweep(config, sweep);
+        return 0;
+    }
+
+    if (config.key_shards > 1)
+    {
+        dispatchCachePolicy(config.cache_type, [&](auto policy)
+                            { runSharded<decltype(policy)>(config); });
+        return 0;
+    }
+
+    dispatchCachePolicy(config.cache_type, [&](auto policy)
+                        { runSimulation<decltype(policy)>(config); });
 
     return 0;
 }